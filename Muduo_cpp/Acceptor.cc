@@ -1,11 +1,14 @@
 #include "Acceptor.h"
 #include "Logger.h"
 #include "InetAddress.h"
+#include "EventLoop.h"
 
 #include <sys/types.h>    
 #include <sys/socket.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <algorithm>
 
 
 static int createNonblocking() // 静态方法，在accept中被调用
@@ -23,9 +26,19 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
     , acceptSocket_(createNonblocking()) // socket
     , acceptChannel_(loop, acceptSocket_.fd())
     , listenning_(false)
+    , acceptBatch_(1)
+    , acceptWakeups_(0)
+    , acceptedConnections_(0)
+    , idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+    , acceptBackoff_(0)
+    , maxAcceptBackoff_(0)
+    , currentBackoff_(0)
+    , paused_(false)
+    , rejectedConnections_(0)
+    , acceptPauses_(0)
 {
     acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    acceptSocket_.setReusePort(reuseport);
     acceptSocket_.bindAddress(listenAddr); // bind
     // TcpServer::start() Acceptor.listen  有新用户的连接，要执行一个回调（connfd=》channel=》subloop）
     // baseLoop => acceptChannel_(listenfd) => 
@@ -34,6 +47,14 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
 
 Acceptor::~Acceptor()
 {
+    if (paused_)
+    {
+        loop_->cancel(resumeTimer_);
+    }
+    if (idleFd_ >= 0)
+    {
+        ::close(idleFd_);
+    }
     acceptChannel_.disableAll(); // 把从poller中感兴趣事件删除
     acceptChannel_.remove();// 调用eventlopp-》removechannel=》poller-》removechannel 把poller中channelmap对应部分删除
 }
@@ -50,27 +71,96 @@ void Acceptor::listen()
 }
 
 // handleRead() 接受新连接，并且以负载均衡的选择方式选择一个subEventLoop，并把这个新连接分发到这个subEventLoop上
+// 一直accept到EAGAIN或者acceptBatch_个，再把这一批连接一起交给上层
 void Acceptor::handleRead() // 有链接过来了
 {
-    InetAddress peerAddr;
-    int connfd = acceptSocket_.accept(&peerAddr);
-    if (connfd >= 0)
+    acceptWakeups_.fetch_add(1, std::memory_order_relaxed);
+    accepted_.clear();
+    bool exhausted = false;
+    while (static_cast<int>(accepted_.size()) < acceptBatch_)
     {
-        if (newConnectionCallback_)
+        InetAddress peerAddr;
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd < 0) // 错误处理
         {
-            newConnectionCallback_(connfd, peerAddr); // 轮询找到subLoop，唤醒，分发当前的新客户端的Channel
+            int savedErrno = errno; // LOG_ERROR可能会改写errno
+            if (savedErrno != EAGAIN && savedErrno != EWOULDBLOCK) // 已经没有等待accept的连接了，不是错误
+            {
+                LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, savedErrno);
+                if (savedErrno == EMFILE || savedErrno == ENFILE) // EMFILE 表示文件描述符达到上限
+                {
+                    LOG_ERROR("%s:%s:%d sockfd reached limit! \n", __FILE__, __FUNCTION__, __LINE__);
+                    exhausted = true;
+                    handleFdExhausted();
+                }
+            }
+            break;
         }
-        else
+        accepted_.push_back(AcceptedConnection{connfd, peerAddr});
+    }
+    if (!accepted_.empty() && !exhausted)
+    {
+        // fd又够用了，暂停时长回到初始值；这一批最后碰到了EMFILE时不能重置，否则handleFdExhausted刚加倍的暂停时长就白费了
+        currentBackoff_ = acceptBackoff_;
+    }
+    if (accepted_.empty())
+    {
+        return;
+    }
+    acceptedConnections_.fetch_add(accepted_.size(), std::memory_order_relaxed);
+
+    if (newConnectionBatchCallback_)
+    {
+        newConnectionBatchCallback_(accepted_);
+    }
+    else if (newConnectionCallback_)
+    {
+        for (const AcceptedConnection &accepted : accepted_)
         {
-            ::close(connfd);
+            newConnectionCallback_(accepted.sockfd, accepted.peerAddr); // 轮询找到subLoop，唤醒，分发当前的新客户端的Channel
+        }
+    }
+    else
+    {
+        for (const AcceptedConnection &accepted : accepted_)
+        {
+            ::close(accepted.sockfd);
         }
     }
-    else // 错误处理
+}
+
+void Acceptor::handleFdExhausted()
+{
+    // 关闭预留的fd腾出一个位置，把排在最前面的连接accept出来马上关闭，客户端收到的是连接关闭而不是一直挂着
+    if (idleFd_ < 0)
+    {
+        idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+    if (idleFd_ >= 0)
     {
-        LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
-        if (errno == EMFILE) // EMFILE 表示文件描述符达到上限
+        ::close(idleFd_);
+        int connfd = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+        if (connfd >= 0)
         {
-            LOG_ERROR("%s:%s:%d sockfd reached limit! \n", __FILE__, __FUNCTION__, __LINE__);
+            ::close(connfd);
+            rejectedConnections_.fetch_add(1, std::memory_order_relaxed);
         }
+        idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC); // ENFILE时可能打不开，下次用完时再试
+    }
+
+    if (acceptBackoff_ > 0 && !paused_)
+    {
+        LOG_ERROR("%s:%s:%d pause accepting for %.3f seconds \n", __FILE__, __FUNCTION__, __LINE__, currentBackoff_);
+        paused_ = true;
+        acceptPauses_.fetch_add(1, std::memory_order_relaxed);
+        acceptChannel_.disableReading();
+        resumeTimer_ = loop_->runAfter(currentBackoff_, std::bind(&Acceptor::resumeAccepting, this));
+        currentBackoff_ = std::min(currentBackoff_ * 2, maxAcceptBackoff_);
     }
+}
+
+void Acceptor::resumeAccepting()
+{
+    paused_ = false;
+    acceptChannel_.enableReading();
 }
\ No newline at end of file
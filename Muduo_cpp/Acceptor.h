@@ -2,16 +2,29 @@
 #include "noncopyable.h"
 #include "Socket.h"
 #include "Channel.h"
+#include "InetAddress.h"
+#include "TimerId.h"
 
+#include <atomic>
 #include <functional>
+#include <vector>
 
 class EventLoop;
-class InetAddress;
 
 class Acceptor : noncopyable
 {
 public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
+
+    struct AcceptedConnection
+    {
+        int sockfd;
+        InetAddress peerAddr;
+    };
+    using AcceptedList = std::vector<AcceptedConnection>;
+    // 一次可读事件中accept到的所有连接
+    using NewConnectionBatchCallback = std::function<void(const AcceptedList&)>;
+
     Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport);
     ~Acceptor();
 
@@ -19,11 +32,41 @@ public:
     {
         newConnectionCallback_ = cb;
     }
+    // 设置了批量回调时优先使用，不再逐个调用newConnectionCallback_
+    void setNewConnectionBatchCallback(const NewConnectionBatchCallback &cb)
+    {
+        newConnectionBatchCallback_ = cb;
+    }
+
+    // 每次可读事件最多accept多少个连接，一直accept到EAGAIN或者达到上限，默认1，必须在listen之前设置
+    // 连接风暴时一次epoll_wait就能接下一批连接
+    void setAcceptBatch(int maxAccepts) { acceptBatch_ = maxAccepts > 0 ? maxAccepts : 1; }
+
+    // 统计：可读事件次数和accept到的连接数，两者之比就是平均每次唤醒accept的连接数，可以在任意线程读取
+    int64_t acceptWakeups() const { return acceptWakeups_.load(std::memory_order_relaxed); }
+    int64_t acceptedConnections() const { return acceptedConnections_.load(std::memory_order_relaxed); }
+
+    // fd用完(EMFILE/ENFILE)时暂停accept initialSeconds秒，连续用完时每次加倍，最多maxSeconds秒，accept成功后恢复
+    // 默认0不暂停，只靠预留的fd拒绝连接；ENFILE时预留的fd可能也打不开，这时只有暂停能让loop不空转
+    void setAcceptBackoff(double initialSeconds, double maxSeconds)
+    {
+        acceptBackoff_ = initialSeconds > 0 ? initialSeconds : 0;
+        maxAcceptBackoff_ = maxSeconds > acceptBackoff_ ? maxSeconds : acceptBackoff_;
+        currentBackoff_ = acceptBackoff_;
+    }
+
+    // 统计：fd用完时accept后直接关闭的连接数，以及暂停accept的次数，可以在任意线程读取
+    int64_t rejectedConnections() const { return rejectedConnections_.load(std::memory_order_relaxed); }
+    int64_t acceptPauses() const { return acceptPauses_.load(std::memory_order_relaxed); }
 
     bool listenning() const { return listenning_; }
     void listen();
+    EventLoop* ownerLoop() const { return loop_; }
 private:
     void handleRead(); //回调函数
+    // fd用完了，用预留的fd把排队的连接accept出来关闭，并按需暂停accept
+    void handleFdExhausted();
+    void resumeAccepting();
     
     EventLoop *loop_; // 这里的loop永远指向主reactor的eventloop，即testservers中创建的loop，Acceptor用的就是用户定义的那个baseLoop，也称作mainLoop
     Socket acceptSocket_; // 这个是服务器监听套接字的文件描述符
@@ -31,5 +74,21 @@ private:
     NewConnectionCallback newConnectionCallback_; 
     // TcpServer构造函数中将TcpServer::newConnection( )函数注册给了这个成员变量。
     // 这个TcpServer::newConnection函数的功能是公平的选择一个subEventLoop，并把已经接受的连接分发给这个subEventLoop。
+    NewConnectionBatchCallback newConnectionBatchCallback_;
     bool listenning_;
+    int acceptBatch_;
+    AcceptedList accepted_; // 本次可读事件accept到的连接，重复使用
+    std::atomic<int64_t> acceptWakeups_;
+    std::atomic<int64_t> acceptedConnections_;
+
+    // 预先打开的/dev/null，fd用完时关闭它腾出一个位置，accept并关闭新连接后再重新打开
+    // 否则监听socket一直可读，水平触发的poller会让baseLoop空转占满一个核
+    int idleFd_;
+    double acceptBackoff_;
+    double maxAcceptBackoff_;
+    double currentBackoff_; // 下一次暂停的时长
+    bool paused_;
+    TimerId resumeTimer_;
+    std::atomic<int64_t> rejectedConnections_;
+    std::atomic<int64_t> acceptPauses_;
 };
\ No newline at end of file
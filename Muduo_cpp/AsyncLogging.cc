@@ -0,0 +1,143 @@
+#include "AsyncLogging.h"
+#include "LogFile.h"
+#include "Timestamp.h"
+
+#include <stdio.h>
+#include <chrono>
+
+const size_t AsyncLogging::kBufferSize;
+const size_t AsyncLogging::kMaxPendingBuffers;
+
+AsyncLogging::AsyncLogging(const std::string &basename,
+                        off_t rollSize,
+                        int flushInterval)
+    : flushInterval_(flushInterval)
+    , running_(false)
+    , basename_(basename)
+    , rollSize_(rollSize)
+    , thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging")
+    , currentBuffer_(new LogBuffer)
+    , nextBuffer_(new LogBuffer)
+    , droppedBuffers_(0)
+{
+    buffers_.reserve(16);
+}
+
+AsyncLogging::~AsyncLogging()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void AsyncLogging::append(const char *logline, size_t len)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (currentBuffer_->avail() > len)
+    {
+        currentBuffer_->append(logline, len);
+        return;
+    }
+
+    // 当前缓冲区写满了，交给后台线程，换一块空的继续写
+    buffers_.push_back(std::move(currentBuffer_));
+    if (nextBuffer_)
+    {
+        currentBuffer_ = std::move(nextBuffer_);
+    }
+    else
+    {
+        currentBuffer_.reset(new LogBuffer); // 前端写得太快，两块都用完了，很少发生
+    }
+    currentBuffer_->append(logline, len);
+    cond_.notify_one();
+}
+
+void AsyncLogging::start()
+{
+    running_ = true;
+    thread_.start();
+}
+
+void AsyncLogging::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = false;
+        cond_.notify_one();
+    }
+    thread_.join();
+}
+
+void AsyncLogging::threadFunc()
+{
+    LogFile output(basename_, rollSize_, flushInterval_);
+    BufferPtr newBuffer1(new LogBuffer);
+    BufferPtr newBuffer2(new LogBuffer);
+    BufferVector buffersToWrite;
+    buffersToWrite.reserve(16);
+
+    bool running = true;
+    while (running)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (buffers_.empty() && running_)
+            {
+                cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+            }
+            running = running_;
+            // 当前缓冲区哪怕没写满也一起换出来，保证日志最多延迟flushInterval秒落盘
+            buffers_.push_back(std::move(currentBuffer_));
+            currentBuffer_ = std::move(newBuffer1);
+            buffersToWrite.swap(buffers_);
+            if (!nextBuffer_)
+            {
+                nextBuffer_ = std::move(newBuffer2);
+            }
+        }
+
+        // 下面都在锁外，前端可以继续写
+        if (buffersToWrite.size() > kMaxPendingBuffers)
+        {
+            char buf[256];
+            snprintf(buf, sizeof buf, "Dropped log messages at %s, %zu buffers\n",
+                Timestamp::now().toString().c_str(), buffersToWrite.size() - 2);
+            fputs(buf, stderr);
+            output.append(buf, strlen(buf));
+            droppedBuffers_ += buffersToWrite.size() - 2;
+            buffersToWrite.resize(2);
+        }
+
+        for (const BufferPtr &buffer : buffersToWrite)
+        {
+            output.append(buffer->data(), buffer->length());
+        }
+
+        // 留两块用来补充newBuffer1/newBuffer2，多出来的释放掉
+        if (buffersToWrite.size() > 2)
+        {
+            buffersToWrite.resize(2);
+        }
+        if (!newBuffer1)
+        {
+            newBuffer1 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer1->reset();
+        }
+        if (!newBuffer2 && !buffersToWrite.empty())
+        {
+            newBuffer2 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer2->reset();
+        }
+        if (!newBuffer2)
+        {
+            newBuffer2.reset(new LogBuffer);
+        }
+        buffersToWrite.clear();
+        output.flush();
+    }
+    output.flush();
+}
\ No newline at end of file
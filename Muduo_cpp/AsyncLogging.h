@@ -0,0 +1,77 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+/**
+ * 异步日志的后端，用法：
+ *   AsyncLogging log("server", 500*1024*1024);
+ *   log.start();
+ *   Logger::setOutput(...); // 在输出函数中调用log.append
+ * 前端(各个io线程)只把日志行拷进当前的4M缓冲区，持锁时间只有一次memcpy；
+ * 缓冲区写满或者每flushInterval秒，后台线程把写满的缓冲区整批换出来，在锁外写入LogFile
+ * 前后端各有两块缓冲区轮换使用，正常情况下不会再分配内存
+ */
+class AsyncLogging : noncopyable
+{
+public:
+    AsyncLogging(const std::string &basename,
+                off_t rollSize,
+                int flushInterval = 3);
+    ~AsyncLogging();
+
+    // 线程安全，由Logger的输出函数调用
+    void append(const char *logline, size_t len);
+
+    void start();
+    void stop(); // 写完已经提交的日志以后退出后台线程
+
+    // 后台线程来不及写、被丢弃的缓冲区个数
+    int64_t droppedBuffers() const { return droppedBuffers_; }
+
+private:
+    static const size_t kBufferSize = 4 * 1024 * 1024;
+    static const size_t kMaxPendingBuffers = 25; // 积压超过100M说明日志写得太多了，只保留最前面两块
+
+    // 固定大小的日志缓冲区
+    class LogBuffer : noncopyable
+    {
+    public:
+        LogBuffer(): cur_(data_) {}
+
+        void append(const char *buf, size_t len) { memcpy(cur_, buf, len); cur_ += len; }
+        const char* data() const { return data_; }
+        size_t length() const { return static_cast<size_t>(cur_ - data_); }
+        size_t avail() const { return static_cast<size_t>(data_ + sizeof data_ - cur_); }
+        void reset() { cur_ = data_; }
+    private:
+        char data_[kBufferSize];
+        char *cur_;
+    };
+
+    using BufferPtr = std::unique_ptr<LogBuffer>;
+    using BufferVector = std::vector<BufferPtr>;
+
+    void threadFunc();
+
+    const int flushInterval_;
+    std::atomic_bool running_;
+    const std::string basename_;
+    const off_t rollSize_;
+    Thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    BufferPtr currentBuffer_; // 前端正在写的缓冲区
+    BufferPtr nextBuffer_;    // 备用的空缓冲区
+    BufferVector buffers_;    // 已经写满、等待后台线程写文件的缓冲区
+    std::atomic<int64_t> droppedBuffers_;
+};
\ No newline at end of file
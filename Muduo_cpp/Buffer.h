@@ -18,6 +18,14 @@ public:
         , writerIndex_(kCheapPrepend) 
     {}
 
+    // 交换两个缓冲区的内容，只交换vector内部的指针，不拷贝数据
+    void swap(Buffer &rhs)
+    {
+        buffer_.swap(rhs.buffer_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+    }
+
     // 将缓冲区划分为3个部分，计算每个部分的长度
     size_t readableBytes() const { return writerIndex_ - readerIndex_; } // 
     size_t writableBytes() const { return buffer_.size() - writerIndex_;}
@@ -74,6 +82,12 @@ public:
         writerIndex_ += len;
     }
 
+    // 直接往beginWrite()写入len字节以后调用，比如io_uring的recv完成之后
+    void hasWritten(size_t len)
+    {
+        writerIndex_ += len;
+    }
+
     char* beginWrite()
     {
         return begin() + writerIndex_;
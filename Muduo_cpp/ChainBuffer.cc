@@ -0,0 +1,157 @@
+#include "ChainBuffer.h"
+
+#include <string.h>
+#include <algorithm>
+
+const size_t BlockPool::kBlockSize;
+const size_t BlockPool::kDefaultMaxFreeBlocks;
+
+BlockPool::BlockPool(size_t maxFreeBlocks)
+    : freeList_(nullptr)
+    , numFree_(0)
+    , maxFreeBlocks_(maxFreeBlocks)
+{
+}
+
+BlockPool::~BlockPool()
+{
+    while (freeList_)
+    {
+        Block *block = freeList_;
+        freeList_ = block->next;
+        delete block;
+    }
+}
+
+BlockPool::Block* BlockPool::get()
+{
+    Block *block = freeList_;
+    if (block)
+    {
+        freeList_ = block->next;
+        --numFree_;
+    }
+    else
+    {
+        block = new Block;
+    }
+    block->next = nullptr;
+    block->readIndex = 0;
+    block->writeIndex = 0;
+    return block;
+}
+
+void BlockPool::put(Block *block)
+{
+    if (numFree_ >= maxFreeBlocks_)
+    {
+        delete block; // 空闲块足够多了，直接还给系统
+        return;
+    }
+    block->next = freeList_;
+    freeList_ = block;
+    ++numFree_;
+}
+
+ChainBuffer::ChainBuffer(BlockPool *pool)
+    : pool_(pool)
+    , head_(nullptr)
+    , tail_(nullptr)
+    , numBlocks_(0)
+    , readableBytes_(0)
+{
+}
+
+ChainBuffer::~ChainBuffer()
+{
+    retrieveAll();
+}
+
+void ChainBuffer::pushBlock(BlockPool::Block *block)
+{
+    block->next = nullptr;
+    if (tail_)
+    {
+        tail_->next = block;
+    }
+    else
+    {
+        head_ = block;
+    }
+    tail_ = block;
+    ++numBlocks_;
+}
+
+void ChainBuffer::append(const char *data, size_t len)
+{
+    readableBytes_ += len;
+    while (len > 0)
+    {
+        if (tail_ == nullptr || tail_->writableBytes() == 0)
+        {
+            pushBlock(pool_->get());
+        }
+        size_t n = std::min(len, tail_->writableBytes());
+        memcpy(tail_->data + tail_->writeIndex, data, n);
+        tail_->writeIndex += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void ChainBuffer::retrieve(size_t len)
+{
+    len = std::min(len, readableBytes_);
+    readableBytes_ -= len;
+    while (len > 0)
+    {
+        size_t n = std::min(len, head_->readableBytes());
+        head_->readIndex += n;
+        len -= n;
+        if (head_->readableBytes() == 0) // 头块读完了，还给pool
+        {
+            BlockPool::Block *block = head_;
+            head_ = block->next;
+            if (head_ == nullptr)
+            {
+                tail_ = nullptr;
+            }
+            --numBlocks_;
+            pool_->put(block);
+        }
+    }
+}
+
+void ChainBuffer::retrieveAll()
+{
+    while (head_)
+    {
+        BlockPool::Block *block = head_;
+        head_ = block->next;
+        pool_->put(block);
+    }
+    tail_ = nullptr;
+    numBlocks_ = 0;
+    readableBytes_ = 0;
+}
+
+int ChainBuffer::peekIovecs(size_t skip, size_t len, struct iovec *vec, int maxIovecs) const
+{
+    int iovcnt = 0;
+    for (BlockPool::Block *block = head_; block && len > 0 && iovcnt < maxIovecs; block = block->next)
+    {
+        size_t readable = block->readableBytes();
+        if (skip >= readable)
+        {
+            skip -= readable;
+            continue;
+        }
+        size_t n = std::min(len, readable - skip);
+        vec[iovcnt].iov_base = const_cast<char*>(block->data + block->readIndex + skip);
+        vec[iovcnt].iov_len = n;
+        ++iovcnt;
+        len -= n;
+        skip = 0;
+    }
+    return iovcnt;
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/**
+ * 固定大小内存块的空闲链表，每个EventLoop一个，只在loop所在的线程中使用，不加锁
+ * ChainBuffer用完的块还给BlockPool，下一次append直接复用，避免反复向系统申请大块内存
+ * 空闲块超过maxFreeBlocks时直接释放，防止一次突发流量之后一直占着内存
+ */
+class BlockPool : noncopyable
+{
+public:
+    static const size_t kBlockSize = 16 * 1024; // 每个块16K
+    static const size_t kDefaultMaxFreeBlocks = 256; // 默认最多缓存4M
+
+    struct Block
+    {
+        Block *next;
+        size_t readIndex;  // 块内可读数据的起始位置
+        size_t writeIndex; // 块内可写位置
+        char data[kBlockSize];
+
+        size_t readableBytes() const { return writeIndex - readIndex; }
+        size_t writableBytes() const { return kBlockSize - writeIndex; }
+    };
+
+    explicit BlockPool(size_t maxFreeBlocks = kDefaultMaxFreeBlocks);
+    ~BlockPool();
+
+    Block* get();           // 取一个空块
+    void put(Block *block); // 归还一个块
+
+    size_t freeBlocks() const { return numFree_; }
+    void setMaxFreeBlocks(size_t maxFreeBlocks) { maxFreeBlocks_ = maxFreeBlocks; }
+
+private:
+    Block *freeList_;
+    size_t numFree_;
+    size_t maxFreeBlocks_;
+};
+
+/**
+ * 由固定大小的块串起来的缓冲区，开启后用于存放TcpConnection发送队列中拷贝进来的数据
+ * Buffer是一整块连续的vector，对端接收慢时发送缓冲区会涨到很大，需要一次性分配大块连续内存，
+ * 并且makeSpace的时候还要整体拷贝；ChainBuffer只在尾部追加块、从头部归还块，append和retrieve都不移动已有数据
+ * 发送时由OutputQueue用peekIovecs取出块区间，和其他片段一起writev
+ */
+class ChainBuffer : noncopyable
+{
+public:
+    explicit ChainBuffer(BlockPool *pool);
+    ~ChainBuffer();
+
+    size_t readableBytes() const { return readableBytes_; }
+    size_t numBlocks() const { return numBlocks_; }
+
+    // 把 [data, data+len] 追加到链的尾部，尾块写满就从pool取新块
+    void append(const char *data, size_t len);
+
+    // 从头部丢弃len字节，读完的块立刻还给pool
+    void retrieve(size_t len);
+    void retrieveAll();
+
+    // 跳过前skip字节，把接下来len字节所在的块区间填入vec，最多maxIovecs个，返回填了几个
+    int peekIovecs(size_t skip, size_t len, struct iovec *vec, int maxIovecs) const;
+
+private:
+    void pushBlock(BlockPool::Block *block);
+
+    BlockPool *pool_; // 块从这里来，也还回这里
+    BlockPool::Block *head_; // 最老的块，从这里读
+    BlockPool::Block *tail_; // 最新的块，往这里写
+    size_t numBlocks_;
+    size_t readableBytes_;
+};
\ No newline at end of file
@@ -7,6 +7,7 @@
 const int Channel::kNoneEvent = 0;
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI; 
 const int Channel::kWriteEvent = EPOLLOUT;
+const int Channel::kEdgeTriggered = EPOLLET;
 
 // EventLoop: ChannelList Poller
 Channel::Channel(EventLoop *loop, int fd): loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), tied_(false) {}
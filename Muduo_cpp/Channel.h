@@ -44,7 +44,7 @@ public:
     int fd() const { return fd_; } // 返回文件描述符
     int events() const { return events_; } // 返回我们关心的事件
     // 当事件监听器监听到某个文件描述符发生了什么事件，通过 set_revents() 函数可以将这个文件描述符实际发生的事件封装进这个Channel中
-    int set_revents(int revt) { revents_ = revt; } 
+    void set_revents(int revt) { revents_ = revt; }
 
     // 将Channel中的文件描述符及其感兴趣事件注册事件监听器上或从事件监听器上移除.
     // 外部通过这几个函数来告知Channel你所监管的文件描述符都对哪些事件类型感兴趣，
@@ -54,10 +54,24 @@ public:
     void disableReading() { events_ &= ~kReadEvent; update(); }  // 让event对读事件不感兴趣
     void enableWriting() { events_ |= kWriteEvent; update(); }   
     void disableWriting() { events_ &= ~kWriteEvent; update(); }
-    void disableAll() { events_ = kNoneEvent; update(); }
+    void disableAll() { events_ &= kEdgeTriggered; update(); } // 保留触发方式
+    // 同时关注读写事件，只需要一次epoll_ctl，边沿触发的连接建立时使用
+    void enableReadingAndWriting() { events_ |= kReadEvent | kWriteEvent; update(); }
+
+    // 边沿触发(EPOLLET)：只有fd的状态发生变化时才通知一次，回调必须一直读写到EAGAIN，否则剩下的数据不会再有通知
+    // 一般在enableReading之前设置，已经注册了事件时会立即更新到poller
+    void setEdgeTriggered(bool on)
+    {
+        events_ = on ? (events_ | kEdgeTriggered) : (events_ & ~kEdgeTriggered);
+        if (!isNoneEvent())
+        {
+            update();
+        }
+    }
 
     // 返回fd当前的事件状态
-    bool isNoneEvent() const { return events_ == kNoneEvent; }
+    bool isNoneEvent() const { return (events_ & ~kEdgeTriggered) == kNoneEvent; }
+    bool isEdgeTriggered() const { return events_ & kEdgeTriggered; }
     bool isWriting() const { return events_ & kWriteEvent; }
     bool isReading() const { return events_ & kReadEvent; }
 
@@ -76,6 +90,7 @@ private:
     static const int kNoneEvent;  // 0 任何事件都不感兴趣
     static const int kReadEvent;  // EPOLLIN | EPOLLPRI 记录对读事件感兴趣
     static const int kWriteEvent; // EPOLLOUT 记录写事件感兴趣
+    static const int kEdgeTriggered; // EPOLLET 不是事件，只是触发方式
 
     EventLoop *loop_; // 记录这个channel属于哪个eventloop对象
     const int fd_;    // fd, Poller监听的对象
@@ -93,5 +108,4 @@ private:
     EventCallback writeCallback_;
     EventCallback closeCallback_;
     EventCallback errorCallback_;
-};
-
+};
\ No newline at end of file
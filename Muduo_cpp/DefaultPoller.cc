@@ -1,14 +1,24 @@
 #include "Poller.h"
 #include "EPollPoller.h"
+#include "PollPoller.h"
+#include "IoUringPoller.h"
+#include "Logger.h"
 
 #include <stdlib.h>
 
 Poller* Poller::newDefaultPoller(EventLoop *loop){
     if (::getenv("MUDUO_USE_POLL"))
     { //环境变量如果有MUDUO_USE_POLL，则使用poll
-        return nullptr; // 生成poll的实例
+        return new PollPoller(loop); // 生成poll的实例
     }
-    else{
-        return new EPollPoller(loop); // 生成epoll的实例，使用epoll
+    if (::getenv("MUDUO_USE_IO_URING"))
+    { //环境变量如果有MUDUO_USE_IO_URING，则使用io_uring，内核不支持时退回epoll
+        Poller *poller = IoUringPoller::newPoller(loop);
+        if (poller)
+        {
+            return poller;
+        }
+        LOG_ERROR("io_uring is not available, fall back to epoll \n");
     }
+    return new EPollPoller(loop); // 生成epoll的实例，使用epoll
 }
\ No newline at end of file
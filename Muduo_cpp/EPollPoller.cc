@@ -5,6 +5,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <strings.h>
+#include <algorithm>
 
 // channel未添加到poller中
 const int kNew = -1;  // channel的成员index_ = -1
@@ -14,7 +15,8 @@ const int kAdded = 1;
 const int kDeleted = 2;
 
 EPollPoller::EPollPoller(EventLoop *loop): Poller(loop), epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
-events_(kInitEventListSize)  // vector<epoll_event> kInitEventListSize = 16;
+events_(kInitEventListSize),  // vector<epoll_event> kInitEventListSize = 16;
+lowActivityPolls_(0)
 {
     if (epollfd_ < 0)
     {
@@ -28,7 +30,7 @@ EPollPoller::~EPollPoller() {
 /*
 这个函数可以说是Poller的核心了，当外部调用poll方法的时候，
 该方法底层其实是通过epoll_wait获取这个事件监听器上发生事件的fd及其对应发生的事件，
-我们知道每个fd都是由一个Channel封装的，通过哈希表channels_可以根据fd找到封装这个fd的Channel。
+我们知道每个fd都是由一个Channel封装的，通过channels_可以根据fd找到封装这个fd的Channel。
 将事件监听器监听到该fd发生的事件写进这个Channel中的revents成员变量中。然后把这个Channel装进activeChannels中（它是一个vector<Channel*>）。
 这样，当外界调用完poll之后就能拿到事件监听器的监听结果（activeChannels_）
 这个activeChannels就是事件监听器监听到的发生事件的fd，以及每个fd都发生了什么事件。
@@ -36,17 +38,20 @@ EPollPoller::~EPollPoller() {
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels){
     // 实际上应该用LOG_DEBUG输出日志更为合理
     LOG_INFO("func=%s => fd total count:%lu \n", __FUNCTION__, channels_.size());
+    applyPendingUpdates();
 
-    int numEvents = ::epoll_wait(epollfd_, &*events_.begin(), static_cast<int>(events_.size()), timeoutMs); //等待监听
+    int maxEvents = static_cast<int>(events_.size());
+    if (maxEventsPerPoll_ > 0)
+    {
+        maxEvents = std::min(maxEvents, maxEventsPerPoll_); // 剩下的就绪事件留在内核的就绪链表中，下一次poll返回
+    }
+    int numEvents = ::epoll_wait(epollfd_, &*events_.begin(), maxEvents, timeoutMs); //等待监听
     int saveErrno = errno;
     Timestamp now(Timestamp::now());
  
     if (numEvents > 0){ //大于0，表示有时间发生
         LOG_INFO("%d events happened \n", numEvents);
         fillActiveChannels(numEvents, activeChannels); // 向activeChannels中填充
-        if (numEvents == events_.size()){ // 扩容操作，如果事件达到最大值，扩容events，2倍扩容
-            events_.resize(events_.size() * 2);
-        }
     }
     else if (numEvents == 0){ //超时
         LOG_DEBUG("%s timeout! \n", __FUNCTION__);
@@ -57,9 +62,37 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels){
             LOG_ERROR("EPollPoller::poll() err!");
         }
     }
+    adjustEventListSize(numEvents);
     return now;
 }
 
+void EPollPoller::adjustEventListSize(int numEvents)
+{
+    size_t size = events_.size();
+    if (numEvents >= 0 && static_cast<size_t>(numEvents) == size)
+    {
+        // 扩容操作，如果事件达到最大值，扩容events，2倍扩容，有上限时不需要超过上限
+        if (maxEventsPerPoll_ == 0 || size < static_cast<size_t>(maxEventsPerPoll_))
+        {
+            events_.resize(size * 2);
+        }
+        lowActivityPolls_ = 0;
+    }
+    else if (size > kInitEventListSize && static_cast<size_t>(std::max(numEvents, 0)) < size / 4)
+    {
+        if (++lowActivityPolls_ >= kShrinkAfterPolls)
+        {
+            events_.resize(size / 2);
+            events_.shrink_to_fit();
+            lowActivityPolls_ = 0;
+        }
+    }
+    else
+    {
+        lowActivityPolls_ = 0;
+    }
+}
+
 // channel update remove => EventLoop updateChannel removeChannel => Poller updateChannel removeChannel
 /**
  *              EventLoop  =>   poller.poll
@@ -70,39 +103,87 @@ void EPollPoller::updateChannel(Channel *channel){
     const int index = channel->index();
     LOG_INFO("func=%s => fd=%d events=%d index=%d \n", __FUNCTION__, channel->fd(), channel->events(), index);
 
+    int fd = channel->fd();
     if (index == kNew || index == kDeleted){ //channel没有注册过或者被删除过了
         if (index == kNew){ // 
-            int fd = channel->fd();
-            channels_[fd] = channel;
+            channels_.add(fd, channel);
+            if (static_cast<size_t>(fd) >= interests_.size()){
+                interests_.resize(std::max(static_cast<size_t>(fd) + 1, interests_.size() * 2));
+            }
         }
         channel->set_index(kAdded);
-        update(EPOLL_CTL_ADD, channel);
     }
-    else  // channel已经在poller上注册过了
+    else if (channel->isNoneEvent()){ // channel已经在poller上注册过了，对任何事件都不感兴趣
+        channel->set_index(kDeleted); 
+    }
+
+    // 真正的epoll_ctl推迟到下一次epoll_wait之前
+    Interest &interest = interests_[fd];
+    if (interest.dirty){
+        ctlElided_.fetch_add(1, std::memory_order_relaxed); // 和本轮之前的变化合并
+    }
+    else{
+        interest.dirty = true;
+        dirtyFds_.push_back(fd);
+    }
+}
+
+void EPollPoller::applyPendingUpdates()
+{
+    for (int fd : dirtyFds_)
     {
-        int fd = channel->fd();
-        if (channel->isNoneEvent()){ // 对任何事件不感兴趣
-            update(EPOLL_CTL_DEL, channel); //删除channel
-            channel->set_index(kDeleted); 
+        Interest &interest = interests_[fd];
+        if (!interest.dirty)
+        {
+            continue; // 已经removeChannel了
+        }
+        interest.dirty = false;
+
+        Channel *channel = channels_.find(fd);
+        bool wanted = channel->index() == kAdded;
+        uint32_t events = static_cast<uint32_t>(channel->events());
+        if (wanted && !interest.inKernel)
+        {
+            update(EPOLL_CTL_ADD, channel);
+            interest.inKernel = true;
+        }
+        else if (!wanted && interest.inKernel)
+        {
+            update(EPOLL_CTL_DEL, channel);
+            interest.inKernel = false;
         }
-        else{ //
+        else if (wanted && interest.kernelEvents != events)
+        {
             update(EPOLL_CTL_MOD, channel);
         }
+        else
+        {
+            ctlElided_.fetch_add(1, std::memory_order_relaxed); // 最终和内核中的一样
+            continue;
+        }
+        interest.kernelEvents = events;
     }
+    dirtyFds_.clear();
 }
 
 // 从poller中删除channel
 void EPollPoller::removeChannel(Channel *channel) 
 {
     int fd = channel->fd();
-    channels_.erase(fd); //unordered_map中
+    channels_.erase(fd);
 
     LOG_INFO("func=%s => fd=%d\n", __FUNCTION__, fd);
     
-    int index = channel->index();
-    if (index == kAdded)
+    Interest &interest = interests_[fd];
+    if (interest.dirty)
+    {
+        interest.dirty = false; // 还没提交的变化不需要了
+        ctlElided_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (interest.inKernel)
     {
         update(EPOLL_CTL_DEL, channel);
+        interest.inKernel = false;
     }
     channel->set_index(kNew);
 }
@@ -131,6 +212,7 @@ void EPollPoller::update(int operation, Channel *channel)
     event.data.fd = fd; 
     event.data.ptr = channel;
     
+    ctlCalls_.fetch_add(1, std::memory_order_relaxed);
     if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
     {
         if (operation == EPOLL_CTL_DEL)
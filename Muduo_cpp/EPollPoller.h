@@ -13,6 +13,13 @@ class Channel;
  * epoll_create
  * epoll_ctl 添加，修改，删除   add/mod/del updateChannel和removeChannel都是ctl方法
  * epoll_wait 对应poll
+ *
+ * updateChannel不立即调用epoll_ctl，只把fd记进脏列表，下一次epoll_wait之前按每个fd最终关注的事件
+ * 和内核中已注册的事件比较，只提交净变化：同一轮中enableWriting又disableWriting的fd不产生任何系统调用
+ * removeChannel之后fd马上会被关闭甚至复用，所以删除仍然立即执行
+ *
+ * events_一次返回满了就扩大一倍（不超过maxEventsPerPoll），连续kShrinkAfterPolls次用量都不到四分之一时缩小一半，
+ * 突发流量过去以后不会一直占着大数组
  */ 
 class EPollPoller : public Poller
 {
@@ -28,15 +35,31 @@ public:
 
 private:
     static const int kInitEventListSize = 16; //epoll_event的数组长度
+    static const int kShrinkAfterPolls = 512;  // 连续这么多次poll用量都很低时缩小events_
 
     // 填写活跃的连接
     void fillActiveChannels(int numEvents, ChannelList *activeChannels) const;
     
     // 更新channel通道 epoll_ctl
     void update(int operation, Channel *channel);
+    // 在epoll_wait之前把脏列表中的变化提交给内核
+    void applyPendingUpdates();
+    // 根据本次返回的事件数调整events_的大小
+    void adjustEventListSize(int numEvents);
+
+    // 每个fd在内核中的注册状态，以fd为下标
+    struct Interest
+    {
+        uint32_t kernelEvents; // 已经提交给内核的事件
+        bool inKernel;         // 已经EPOLL_CTL_ADD过
+        bool dirty;            // 在dirtyFds_中等待提交
+    };
 
     using EventList = std::vector<epoll_event>; //c++中可以省略掉struct，直接写成epoll_event
 
     int epollfd_; // epoll_create创建返回的epoll句柄,保存在epollfd_上
     EventList events_; // 用于存放epoll_wait返回的所有发生的事件的文件描述符事件集合
+    int lowActivityPolls_; // 连续用量不到四分之一的poll次数
+    std::vector<Interest> interests_;
+    std::vector<int> dirtyFds_; // 本轮关注事件发生过变化的fd
 };
\ No newline at end of file
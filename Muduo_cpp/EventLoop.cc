@@ -2,12 +2,15 @@
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "TimerQueue.h"
+#include "ChainBuffer.h"
 
 #include <sys/eventfd.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <memory>
+#include <thread>
 
 
 // 防止一个线程创建多个EventLoop  thread_local
@@ -38,9 +41,17 @@ EventLoop::EventLoop()
     , quit_(false)
     , callingPendingFunctors_(false) // 需要处理的回调
     , threadId_(CurrentThread::tid()) // 获取当前的线程id号
+    , connectionCount_(0)
+    , pendingOutputBytes_(0)
     , poller_(Poller::newDefaultPoller(this)) //获取默认的poller，即epoll
+    , timerQueue_(new TimerQueue(this))       // 创建定时器队列，timerfd注册到poller上
     , wakeupFd_(createEventfd())              // 创建wakeupfd，唤醒subreactor处理新来的channel
     , wakeupChannel_(new Channel(this , wakeupFd_)) //每个subreactor相当于一个eventloop，创建新事件？
+    , wakeupPending_(false)
+    , suppressedWakeups_(0)
+    , busyPollMicros_(0)
+    , spinning_(false)
+    , pendingCount_(0)
 {
     LOG_DEBUG("EventLoop created %p in thread %d \n", this, threadId_);
     if (t_loopInThisThread) // 如果该线程已经创建了循环
@@ -72,14 +83,40 @@ void EventLoop::loop()
     looping_ = true; //开始循环
     quit_ = false;   // 未退出
     LOG_INFO("EventLoop %p start looping \n", this); //事件开始运行
+    int64_t lastBusyMicros = 0; // 忙轮询模式下最近一次有事件或者回调的时间（单调时钟）
     while(!quit_) //while循环，
     {
         // 把eventloop的activatechannels传给epoll方法
         // 当epoll方法调用完epoll_wait()方法后，把有事件发生的channel装入activatechannels数组里面
         activeChannels_.clear();
 
-        // 监听两类fd   一种是client的fd，即和客户端通信的fd，一种wakeupfd 即mainreactor和subreactor的通信fd
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_); 
+        int timeoutMs;
+        int spinMicros = busyPollMicros_.load(std::memory_order_relaxed);
+        int64_t nowMicros = spinMicros > 0 ? Timestamp::monotonicNow().microSecondsSinceEpoch() : 0;
+        if (spinMicros > 0 && nowMicros - lastBusyMicros < spinMicros)
+        {
+            spinning_.store(true);
+            timeoutMs = 0; // 忙轮询，回调在每一轮末尾都会执行，不需要wakeup
+        }
+        else
+        {
+            // 先清除spinning_再检查pendingCount_和quit_，和queueInLoop/quit的先写再检查spinning_配对，
+            // 两边至少有一方能看到对方，不会出现对方省掉了wakeup而loop却阻塞的情况
+            bool checkQuit = false;
+            if (spinning_.load(std::memory_order_relaxed))
+            {
+                spinning_.store(false);
+                checkQuit = true;
+            }
+            // 监听两类fd   一种是client的fd，即和客户端通信的fd，一种wakeupfd 即mainreactor和subreactor的通信fd
+            // 还有回调没有执行（执行回调期间又加入的回调，或者加入时没有触发wakeup），poll不阻塞
+            timeoutMs = (pendingCount_.load() > 0 || (checkQuit && quit_)) ? 0 : kPollTimeMs;
+        }
+        pollReturnTime_ = poller_->poll(timeoutMs, &activeChannels_); 
+        if (spinMicros > 0 && (!activeChannels_.empty() || pendingCount_.load(std::memory_order_relaxed) > 0))
+        {
+            lastBusyMicros = Timestamp::monotonicNow().microSecondsSinceEpoch(); // 有活干，重新开始计算忙轮询窗口
+        }
         // 此时activateChannels中存放了经过epoll的epollwait函数记录的activatechannel
         for (Channel *channel : activeChannels_)
         {
@@ -127,43 +164,37 @@ void EventLoop::runInLoop(Functor cb) //callback
     }
     else // 在非当前loop线程中执行cb , 就需要唤醒loop所在线程，执行cb
     {
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
     }
 }
 // 把cb放入队列中，唤醒loop所在的线程，执行cb
 void EventLoop::queueInLoop(Functor cb)
 {
-    {
-        std::unique_lock<std::mutex> lock(mutex_); //加锁 
-        pendingFunctors_.emplace_back(cb); // vector向队尾添加元素
-    } //解锁
+    pendingFunctors_.push(std::move(cb)); // 无锁入队
 
-    // 唤醒相应的，需要执行上面回调操作的loop的线程
+    // 只有让队列从空变为非空的生产者才需要唤醒，后来的生产者搭便车，loop醒来时会一并执行
     // || callingPendingFunctors_的意思是：当前loop正在执行回调，但是loop又有了新的回调
-    // 这时就要wakeup() loop所在线程，让它继续执行它的回调
-    if (!isInLoopThread() || callingPendingFunctors_) 
+    // 在loop线程中并且没有在执行回调时，说明还没执行到doPendingFunctors()，不需要wakeup
+    if (pendingCount_.fetch_add(1) == 0
+        && (!isInLoopThread() || callingPendingFunctors_))
     {
-        /***
-            这里还需要结合下EventLoop循环的实现，其中doPendingFunctors()是每轮循环的最后一步处理。 
-            如果调用queueInLoop和EventLoop在同一个线程，且callingPendingFunctors_为false时，
-            则说明：此时尚未执行到doPendingFunctors()。 那么此时即使不用wakeup，也可以在之后照旧
-            执行doPendingFunctors()了。这么做的好处非常明显，可以减少对eventfd的io读写。
-        ***/
         wakeup(); // 唤醒loop所在线程
         /***
-            为什么要唤醒 EventLoop，我们首先调用了 pendingFunctors_.push_back(cb), 
+            为什么要唤醒 EventLoop，我们首先调用了 pendingFunctors_.push(cb), 
             将该函数放在 pendingFunctors_中。EventLoop 的每一轮循环在最后会调用 
             doPendingFunctors 依次执行这些函数。而 EventLoop 的唤醒是通过 epoll_wait 实现的，
             如果此时该 EventLoop 中迟迟没有事件触发，那么 epoll_wait 一直就会阻塞。 
             这样会导致，pendingFunctors_中的任务迟迟不能被执行了。
             所以必须要唤醒 EventLoop ，从而让pendingFunctors_中的任务尽快被执行。
         ***/
-
     }
 }
 
 void EventLoop::handleRead()
 {
+  // 先清除标志再读eventfd，清除之后的生产者会重新写一次，保证不会丢失唤醒
+  // 这次handleRead之后本轮循环还会执行doPendingFunctors()，清除之前入队的回调都能被执行到
+  wakeupPending_.store(false);
   uint64_t one = 1;
   ssize_t n = read(wakeupFd_, &one, sizeof one);
   if (n != sizeof one)
@@ -173,8 +204,14 @@ void EventLoop::handleRead()
 }
 
 // 用来唤醒loop所在的线程的  向wakeupfd_写一个数据，wakeupChannel就发生读事件，当前loop线程就会被唤醒
+// 一轮循环中只有第一个调用者真正执行write系统调用，其余的只计数
 void EventLoop::wakeup()
 {
+    if (spinning_.load() || wakeupPending_.exchange(true))
+    {
+        suppressedWakeups_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
     uint64_t one = 1;
     ssize_t n = write(wakeupFd_, &one, sizeof one);
     if (n != sizeof one)
@@ -183,6 +220,28 @@ void EventLoop::wakeup()
     }
 }
 
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), delay));
+    return runAt(time, std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), interval));
+    return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 // EventLoop的方法 =》 Poller的方法
 void EventLoop::updateChannel(Channel *channel)
 {
@@ -199,19 +258,58 @@ bool EventLoop::hasChannel(Channel *channel)
     return poller_->hasChannel(channel);
 }
 
+BlockPool* EventLoop::blockPool()
+{
+    if (!blockPool_)
+    {
+        blockPool_.reset(new BlockPool);
+    }
+    return blockPool_.get();
+}
+
+bool EventLoop::supportsAsyncIo() const
+{
+    return poller_->supportsAsyncIo();
+}
+
+uint64_t EventLoop::asyncRecv(int fd, void *buf, size_t len, Poller::CompletionCallback cb)
+{
+    return poller_->asyncRecv(fd, buf, len, std::move(cb));
+}
+
+uint64_t EventLoop::asyncSendmsg(int fd, const struct msghdr *msg, Poller::CompletionCallback cb)
+{
+    return poller_->asyncSendmsg(fd, msg, std::move(cb));
+}
+
+void EventLoop::cancelAsyncIo(uint64_t id)
+{
+    poller_->cancelAsyncIo(id);
+}
+
 void EventLoop::doPendingFunctors() // 执行回调
 {
-    std::vector<Functor> functors;
     callingPendingFunctors_ = true;
 
+    // 只执行进入时已经计数的回调，执行过程中新加入的留到下一轮，避免回调里不断queueInLoop导致饿死IO
+    const int64_t count = pendingCount_.load();
+    int64_t done = 0;
+    Functor functor;
+    while (done < count)
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        functors.swap(pendingFunctors_);  //  释放pendingFunctors交到functors中去，提升效率，避免死锁
+        if (pendingFunctors_.pop(&functor))
+        {
+            functor(); // 执行当前loop需要执行的回调操作
+            ++done;
+        }
+        else
+        {
+            std::this_thread::yield(); // 某个生产者正处在push的中间状态，等它完成链接
+        }
     }
-
-    for (const Functor &functor : functors)
+    if (count > 0)
     {
-        functor(); // 执行当前loop需要执行的回调操作
+        pendingCount_.fetch_sub(count);
     }
 
     callingPendingFunctors_ = false;
@@ -4,14 +4,18 @@
 #include <vector>
 #include <atomic>
 #include <memory>
-#include <mutex>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "MpscQueue.h"
+#include "Poller.h"
 
 class Channel;
-class Poller;
+class TimerQueue;
+class BlockPool;
 
 // 事件循环类  主要包含了两个大模块 Channel 和 Poller
 class EventLoop : noncopyable
@@ -33,12 +37,49 @@ public:
     void queueInLoop(Functor cb); // 把cb放入队列中，唤醒loop所在的线程，执行cb
 
     void wakeup(); // 用来唤醒loop所在的线程的 主reactor 用来唤醒subreactor
+    // 因为已经有一次wakeup尚未被loop处理、或者loop正在忙轮询而省掉的eventfd write次数
+    int64_t suppressedWakeups() const { return suppressedWakeups_.load(std::memory_order_relaxed); }
+    // poller实际提交的epoll_ctl次数和合并掉的次数，见Poller::controlCalls
+    int64_t pollerControlCalls() const { return poller_->controlCalls(); }
+    int64_t elidedPollerControlCalls() const { return poller_->elidedControlCalls(); }
+
+    // 忙轮询：有事件或回调之后的spinMicros微秒内，poll的超时为0，不阻塞，用一个CPU核换取更低的尾延迟；
+    // 期间queueInLoop不需要写eventfd唤醒；窗口内一直空闲才回到阻塞的poll。0表示关闭，线程安全
+    void setBusyPoll(int spinMicros) { busyPollMicros_.store(spinMicros > 0 ? spinMicros : 0, std::memory_order_relaxed); }
+    int busyPoll() const { return busyPollMicros_.load(std::memory_order_relaxed); }
+
+    // 负载统计，LoadBalancer在baseLoop线程中读取：分配给本loop还没有销毁的连接数、本loop所有连接发送队列中的字节数
+    int64_t connectionCount() const { return connectionCount_.load(std::memory_order_relaxed); }
+    int64_t pendingOutputBytes() const { return pendingOutputBytes_.load(std::memory_order_relaxed); }
+    // TcpConnection构造时加1、connectDestroyed时减1，线程安全
+    void addConnectionCount(int delta) { connectionCount_.fetch_add(delta, std::memory_order_relaxed); }
+    // 交给OutputQueue::setByteCounter
+    std::atomic<int64_t>* pendingOutputBytesCounter() { return &pendingOutputBytes_; }
+
+    // 定时器，线程安全，回调总是在loop所在的线程中执行
+    TimerId runAt(Timestamp time, TimerCallback cb);       // 在time时刻执行cb
+    TimerId runAfter(double delay, TimerCallback cb);      // delay秒之后执行cb
+    TimerId runEvery(double interval, TimerCallback cb);   // 每隔interval秒执行一次cb
+    void cancel(TimerId timerId);                          // 取消定时器
     
     // Channel的方法 => EventLoop的方法 => Poller的方法
     void updateChannel(Channel *channel);
     void removeChannel(Channel *channel);
     bool hasChannel(Channel *channel);
 
+    // 本loop的内存块池，ChainBuffer从这里取块，只能在loop线程中调用
+    BlockPool* blockPool();
+
+    bool supportsEdgeTriggered() const { return poller_->supportsEdgeTriggered(); }
+    // 每轮循环最多处理多少个活跃channel，0表示不限制，只能在loop线程中调用，见Poller::setMaxEventsPerPoll
+    void setMaxEventsPerIteration(int maxEvents) { poller_->setMaxEventsPerPoll(maxEvents); }
+
+    // 完成模式的异步IO，转发给poller_，只能在loop线程中调用，见Poller::asyncRecv
+    bool supportsAsyncIo() const;
+    uint64_t asyncRecv(int fd, void *buf, size_t len, Poller::CompletionCallback cb);
+    uint64_t asyncSendmsg(int fd, const struct msghdr *msg, Poller::CompletionCallback cb);
+    void cancelAsyncIo(uint64_t id);
+
     // 判断EventLoop对象是否在自己的线程里面
     bool isInLoopThread() const { return threadId_ ==  CurrentThread::tid(); }
 
@@ -54,13 +95,22 @@ private:
     const pid_t threadId_; // 记录当前loop所在线程的id
 
     Timestamp pollReturnTime_; // poller返回发生事件的channels的时间点
+    // 下面三个必须在poller_之前声明：~IoUringPoller释放未完成的异步IO回调时会析构TcpConnection，
+    // 它的发送队列要把块还给blockPool_并更新pendingOutputBytes_
+    std::unique_ptr<BlockPool> blockPool_; // 第一次使用时创建
+    std::atomic<int64_t> connectionCount_;
+    std::atomic<int64_t> pendingOutputBytes_;
     std::unique_ptr<Poller> poller_; //指向poller类对象的一个智能指针
+    std::unique_ptr<TimerQueue> timerQueue_; // 定时器队列，timerfd注册在poller_上，所以必须在poller_之后构造
 
     int wakeupFd_; // 主要作用，当mainLoop获取一个新用户的channel，通过轮询算法选择一个subloop，通过该成员唤醒subloop处理channel
     std::unique_ptr<Channel> wakeupChannel_;
-
+    std::atomic_bool wakeupPending_;           // 已经写过wakeupFd_，loop还没有读走，这期间的wakeup都可以省掉
+    std::atomic<int64_t> suppressedWakeups_;   // 省掉的wakeup次数
+    std::atomic<int> busyPollMicros_;          // 忙轮询窗口，0表示关闭
+    std::atomic_bool spinning_;                // loop正在忙轮询，不会阻塞在poll中，wakeup可以省掉
     ChannelList activeChannels_;              // 返回poller检测到的当前有事件发生的所有channel列表
     std::atomic_bool callingPendingFunctors_; // 标识当前loop是否有需要执行的回调操作
-    std::vector<Functor> pendingFunctors_;    // 存储loop需要执行的所有的回调操作
-    std::mutex mutex_;                        // 互斥锁，用来保护上面vector容器的线程安全操作
+    MpscQueue<Functor> pendingFunctors_;      // 存储loop需要执行的所有的回调操作，无锁的多生产者单消费者队列
+    std::atomic<int64_t> pendingCount_;       // 已经push完成的回调个数减去已经执行的个数，从0变为1的生产者负责wakeup
 };
\ No newline at end of file
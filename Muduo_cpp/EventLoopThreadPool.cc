@@ -1,5 +1,7 @@
 #include "EventLoopThreadPool.h"
 #include "EventLoopThread.h"
+#include "EventLoop.h"
+#include "LoadBalancer.h"
 
 #include <memory>
 
@@ -14,6 +16,11 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string
 EventLoopThreadPool::~EventLoopThreadPool() //不用释放loop，loop属于栈空间
 {}
 
+void EventLoopThreadPool::setLoadBalancer(std::unique_ptr<LoadBalancer> balancer)
+{
+    balancer_ = std::move(balancer);
+}
+
 void EventLoopThreadPool::start(const ThreadInitCallback &cb)
 {
     started_ = true;
@@ -25,6 +32,15 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
         EventLoopThread *t = new EventLoopThread(cb, buf);
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         loops_.push_back(t->startLoop());  // 底层创建线程，绑定一个新的EventLoop，并返回该loop的地址
+        if (i < static_cast<int>(busyPollMicros_.size()) && busyPollMicros_[i] > 0)
+        {
+            loops_.back()->setBusyPoll(busyPollMicros_[i]);
+        }
+    }
+
+    if (balancer_ && !loops_.empty())
+    {
+        balancer_->setLoops(loops_);
     }
 
     // 整个服务端只有一个线程，运行着baseloop 就相当于单线程
@@ -34,6 +50,24 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
     }
 }
 
+void EventLoopThreadPool::setThreadBusyPoll(int index, int spinMicros)
+{
+    if (index < 0)
+    {
+        return;
+    }
+    if (index < static_cast<int>(loops_.size()))
+    {
+        loops_[index]->setBusyPoll(spinMicros); // 已经start，直接设置，线程安全
+        return;
+    }
+    if (index >= static_cast<int>(busyPollMicros_.size()))
+    {
+        busyPollMicros_.resize(index + 1, 0);
+    }
+    busyPollMicros_[index] = spinMicros;
+}
+
 // 如果工作在多线程中，baseLoop_默认以轮询的方式分配channel给subloop
 EventLoop* EventLoopThreadPool::getNextLoop()
 {
@@ -52,6 +86,15 @@ EventLoop* EventLoopThreadPool::getNextLoop()
     return loop;
 }
 
+EventLoop* EventLoopThreadPool::getNextLoop(const InetAddress &peerAddr)
+{
+    if (balancer_ && !loops_.empty())
+    {
+        return balancer_->select(peerAddr);
+    }
+    return getNextLoop();
+}
+
 std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
 {
     if (loops_.empty())
@@ -60,6 +103,6 @@ std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
     }
     else
     {
-        loops_;
+        return loops_;
     }
 }
\ No newline at end of file
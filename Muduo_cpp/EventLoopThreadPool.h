@@ -8,6 +8,8 @@
 
 class EventLoop;
 class EventLoopThread;
+class InetAddress;
+class LoadBalancer;
 
 class EventLoopThreadPool : noncopyable
 {
@@ -19,10 +21,18 @@ public:
 
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
 
+    // 让第index个subloop忙轮询，见EventLoop::setBusyPoll，start之前之后都可以调用
+    void setThreadBusyPoll(int index, int spinMicros);
+
     void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
+    // 新连接的分配策略，接管balancer，必须在start之前调用，见LoadBalancer
+    void setLoadBalancer(std::unique_ptr<LoadBalancer> balancer);
+
     // 如果工作在多线程中，baseLoop_默认以轮询的方式分配channel给subloop
     EventLoop* getNextLoop();
+    // 按设置的LoadBalancer为来自peerAddr的新连接选择subloop，没有设置时就是getNextLoop()
+    EventLoop* getNextLoop(const InetAddress &peerAddr);
 
     std::vector<EventLoop*> getAllLoops();
 
@@ -37,4 +47,6 @@ private:
     int next_; //轮询的下标
     std::vector<std::unique_ptr<EventLoopThread>> threads_;
     std::vector<EventLoop*> loops_;
+    std::vector<int> busyPollMicros_; // start之前设置的每个subloop的忙轮询窗口
+    std::unique_ptr<LoadBalancer> balancer_;
 };
\ No newline at end of file
@@ -0,0 +1,515 @@
+#include "IoUringPoller.h"
+#include "Logger.h"
+#include "Channel.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/time_types.h>
+
+// channel未添加到poller中
+const int kNew = -1;
+// channel已添加到poller中
+const int kAdded = 1;
+// channel从poller中删除
+const int kDeleted = 2;
+
+const unsigned IoUringPoller::kRingEntries;
+const unsigned IoUringPoller::kCompletionEntries;
+const uint64_t IoUringPoller::kIgnoredUserData;
+const uint64_t IoUringPoller::kAsyncIoFlag;
+const uint32_t IoUringPoller::kGenerationMask;
+
+IoUringPoller* IoUringPoller::newPoller(EventLoop *loop)
+{
+    IoUringPoller *poller = new IoUringPoller(loop);
+    if (!poller->init())
+    {
+        delete poller;
+        return nullptr;
+    }
+    return poller;
+}
+
+IoUringPoller::IoUringPoller(EventLoop *loop)
+    : Poller(loop)
+    , ringFd_(-1)
+    , multishotSupported_(false)
+    , sqRing_(MAP_FAILED)
+    , sqRingSize_(0)
+    , cqRing_(MAP_FAILED)
+    , cqRingSize_(0)
+    , sqes_(static_cast<io_uring_sqe*>(MAP_FAILED))
+    , sqesSize_(0)
+    , sqHead_(nullptr)
+    , sqTail_(nullptr)
+    , sqMask_(0)
+    , sqEntries_(0)
+    , sqArray_(nullptr)
+    , sqLocalTail_(0)
+    , cqHead_(nullptr)
+    , cqTail_(nullptr)
+    , cqMask_(0)
+    , cqes_(nullptr)
+    , nextGeneration_(1)
+    , round_(0)
+    , nextAsyncIo_(1)
+{
+}
+
+IoUringPoller::~IoUringPoller()
+{
+    if (sqes_ != MAP_FAILED)
+    {
+        ::munmap(sqes_, sqesSize_);
+    }
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+    {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    if (sqRing_ != MAP_FAILED)
+    {
+        ::munmap(sqRing_, sqRingSize_);
+    }
+    if (ringFd_ >= 0)
+    {
+        ::close(ringFd_); // 内核会取消所有还没有完成的poll请求
+    }
+}
+
+bool IoUringPoller::init()
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof params);
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = kCompletionEntries;
+
+    ringFd_ = static_cast<int>(::syscall(__NR_io_uring_setup, kRingEntries, &params));
+    if (ringFd_ < 0)
+    {
+        LOG_ERROR("io_uring_setup error:%d \n", errno);
+        return false;
+    }
+    // 带超时的等待需要EXT_ARG(5.11)，完成队列溢出时不丢事件需要NODROP(5.5)
+    if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP))
+    {
+        LOG_ERROR("io_uring features 0x%x not supported \n", params.features);
+        return false;
+    }
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap)
+    {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED)
+    {
+        LOG_ERROR("io_uring mmap sq ring error:%d \n", errno);
+        return false;
+    }
+    if (singleMmap)
+    {
+        cqRing_ = sqRing_;
+    }
+    else
+    {
+        cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED)
+        {
+            LOG_ERROR("io_uring mmap cq ring error:%d \n", errno);
+            return false;
+        }
+    }
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED)
+    {
+        LOG_ERROR("io_uring mmap sqes error:%d \n", errno);
+        return false;
+    }
+
+    char *sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqLocalTail_ = *sqTail_;
+
+    char *cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // 连接是否使用边沿触发在建立时根据supportsEdgeTriggered决定，所以必须在这里确定，运行中不能再变
+    multishotSupported_ = probeMultishot();
+
+    LOG_INFO("io_uring poller created, fd=%d sq=%u cq=%u multishot=%d \n",
+        ringFd_, params.sq_entries, params.cq_entries, (int)multishotSupported_);
+    return true;
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+    LOG_DEBUG("func=%s => fd total count:%lu \n", __FUNCTION__, channels_.size());
+
+    // 上一轮完成的单次poll重新提交，如果fd仍然就绪，提交时就会立即完成
+    for (int fd : rearmFds_)
+    {
+        Registration *reg = findRegistration(fd);
+        if (reg && reg->armedEvents == 0 && !reg->channel->isNoneEvent())
+        {
+            armPoll(fd, *reg);
+        }
+    }
+    rearmFds_.clear();
+
+    // 完成队列里已经有事件时不再等待
+    bool hasCompletions = *cqHead_ != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    unsigned waitNr = (timeoutMs == 0 || hasCompletions) ? 0 : 1;
+    int ret = submitAndWait(waitNr, timeoutMs);
+    Timestamp now(Timestamp::now());
+
+    if (ret < 0 && ret != -ETIME && ret != -EINTR && ret != -EBUSY)
+    {
+        errno = -ret;
+        LOG_ERROR("IoUringPoller::poll() err:%d \n", -ret);
+    }
+    fillActiveChannels(activeChannels);
+    runCompletions(now);
+    return now;
+}
+
+void IoUringPoller::updateChannel(Channel *channel)
+{
+    const int index = channel->index();
+    const int fd = channel->fd();
+    LOG_DEBUG("func=%s => fd=%d events=%d index=%d \n", __FUNCTION__, fd, channel->events(), index);
+
+    if (index == kNew || index == kDeleted)
+    {
+        if (index == kNew)
+        {
+            channels_.add(fd, channel);
+            if (static_cast<size_t>(fd) >= registrations_.size())
+            {
+                registrations_.resize(std::max(static_cast<size_t>(fd) + 1, registrations_.size() * 2));
+            }
+            Registration &reg = registrations_[fd];
+            reg.channel = channel;
+            reg.generation = 0;
+            reg.armedEvents = 0;
+            reg.multishot = false;
+            reg.revents = 0;
+            reg.activeRound = 0;
+        }
+        channel->set_index(kAdded);
+        armPoll(fd, registrations_[fd]);
+    }
+    else
+    {
+        Registration &reg = registrations_[fd];
+        if (channel->isNoneEvent())
+        {
+            cancelPoll(fd, reg);
+            channel->set_index(kDeleted);
+        }
+        else if (reg.armedEvents != pollEvents(channel) || reg.multishot != wantsMultishot(channel))
+        {
+            // 关注的事件变了，取消旧的poll再按新的事件提交
+            cancelPoll(fd, reg);
+            armPoll(fd, reg);
+        }
+    }
+}
+
+void IoUringPoller::removeChannel(Channel *channel)
+{
+    int fd = channel->fd();
+    channels_.erase(fd);
+    LOG_DEBUG("func=%s => fd=%d\n", __FUNCTION__, fd);
+
+    Registration *reg = findRegistration(fd);
+    if (reg)
+    {
+        cancelPoll(fd, *reg);
+        reg->channel = nullptr;
+    }
+    channel->set_index(kNew);
+}
+
+uint64_t IoUringPoller::asyncRecv(int fd, void *buf, size_t len, CompletionCallback cb)
+{
+    uint64_t id = newAsyncIo(std::move(cb));
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = static_cast<uint32_t>(len);
+    sqe->user_data = id;
+    return id;
+}
+
+uint64_t IoUringPoller::asyncSendmsg(int fd, const struct msghdr *msg, CompletionCallback cb)
+{
+    uint64_t id = newAsyncIo(std::move(cb));
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL; // 对端已经关闭时返回-EPIPE，不产生SIGPIPE
+    sqe->user_data = id;
+    return id;
+}
+
+void IoUringPoller::cancelAsyncIo(uint64_t id)
+{
+    if (asyncIos_.find(id) == asyncIos_.end())
+    {
+        return; // 已经完成了
+    }
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = id;
+    sqe->user_data = kIgnoredUserData;
+}
+
+uint64_t IoUringPoller::newAsyncIo(CompletionCallback cb)
+{
+    uint64_t id = kAsyncIoFlag | nextAsyncIo_++;
+    asyncIos_[id] = std::move(cb);
+    return id;
+}
+
+bool IoUringPoller::probeMultishot()
+{
+    int efd = ::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC); // 计数为1，一直可读
+    if (efd < 0)
+    {
+        LOG_ERROR("io_uring probe eventfd error:%d \n", errno);
+        return false;
+    }
+
+    // 探测请求和取消请求都用kIgnoredUserData，没有收割干净的完成事件以后也会被忽略
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = efd;
+    sqe->poll32_events = EPOLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = kIgnoredUserData;
+    submitAndWait(1, 1000);
+
+    bool supported = false;
+    unsigned head = *cqHead_;
+    if (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+    {
+        const io_uring_cqe *cqe = &cqes_[head & cqMask_];
+        // 不支持的内核返回EINVAL，或者当成单次poll完成，没有IORING_CQE_F_MORE
+        supported = cqe->res > 0 && (cqe->flags & IORING_CQE_F_MORE);
+    }
+    if (supported)
+    {
+        sqe = getSqe();
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = kIgnoredUserData;
+        sqe->user_data = kIgnoredUserData;
+        submitAndWait(2, 1000); // 取消请求自己的完成事件和multishot poll结束的完成事件
+    }
+    __atomic_store_n(cqHead_, __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    ::close(efd);
+    return supported;
+}
+
+uint32_t IoUringPoller::newGeneration()
+{
+    uint32_t generation = nextGeneration_;
+    nextGeneration_ = (nextGeneration_ + 1) & kGenerationMask;
+    return generation;
+}
+
+void IoUringPoller::runCompletions(Timestamp now)
+{
+    // 回调里可能再提交新的操作，所以先收割完再统一执行
+    for (auto &completion : completions_)
+    {
+        completion.first(completion.second, now);
+    }
+    completions_.clear();
+}
+
+io_uring_sqe* IoUringPoller::getSqe()
+{
+    if (sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+    {
+        submitAndWait(0, 0); // 提交队列满了，先把已经填好的提交掉
+    }
+    unsigned index = sqLocalTail_ & sqMask_;
+    io_uring_sqe *sqe = &sqes_[index];
+    memset(sqe, 0, sizeof *sqe);
+    sqArray_[index] = index;
+    ++sqLocalTail_;
+    return sqe;
+}
+
+int IoUringPoller::submitAndWait(unsigned waitNr, int timeoutMs)
+{
+    __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+    unsigned toSubmit = sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof arg);
+    if (waitNr > 0 && timeoutMs > 0)
+    {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+
+    long ret = ::syscall(__NR_io_uring_enter, ringFd_, toSubmit, waitNr,
+                        IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof arg);
+    return ret < 0 ? -errno : static_cast<int>(ret);
+}
+
+uint32_t IoUringPoller::pollEvents(const Channel *channel)
+{
+    return static_cast<uint32_t>(channel->events()) & ~static_cast<uint32_t>(EPOLLET);
+}
+
+bool IoUringPoller::wantsMultishot(const Channel *channel) const
+{
+    return multishotSupported_ && (channel->events() & EPOLLET);
+}
+
+void IoUringPoller::armPoll(int fd, Registration &reg)
+{
+    bool multishot = wantsMultishot(reg.channel);
+    uint32_t events = pollEvents(reg.channel);
+    if (events == 0)
+    {
+        return;
+    }
+
+    reg.generation = newGeneration();
+    reg.armedEvents = events;
+    reg.multishot = multishot;
+
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->len = multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = makeUserData(fd, reg.generation);
+}
+
+void IoUringPoller::cancelPoll(int fd, Registration &reg)
+{
+    if (reg.armedEvents == 0)
+    {
+        return;
+    }
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(fd, reg.generation);
+    sqe->user_data = kIgnoredUserData;
+
+    // 换一个generation，被取消的请求之后再产生的完成事件都会被丢掉
+    reg.generation = newGeneration();
+    reg.armedEvents = 0;
+}
+
+// 收割完成队列，向activeChannels中填充活跃事件
+void IoUringPoller::fillActiveChannels(ChannelList *activeChannels)
+{
+    ++round_;
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+        if (maxEventsPerPoll_ > 0
+            && activeChannels->size() + completions_.size() >= static_cast<size_t>(maxEventsPerPoll_))
+        {
+            break; // 剩下的完成事件留在完成队列里，下一次poll不等待直接收割
+        }
+        const io_uring_cqe *cqe = &cqes_[head & cqMask_];
+        uint64_t userData = cqe->user_data;
+        if (userData == kIgnoredUserData)
+        {
+            continue;
+        }
+        if (userData & kAsyncIoFlag)
+        {
+            auto op = asyncIos_.find(userData);
+            if (op != asyncIos_.end())
+            {
+                completions_.emplace_back(std::move(op->second), cqe->res);
+                asyncIos_.erase(op);
+            }
+            continue;
+        }
+        int fd = static_cast<int>(static_cast<uint32_t>(userData));
+        uint32_t generation = static_cast<uint32_t>(userData >> 32);
+        Registration *found = findRegistration(fd);
+        if (!found || found->generation != generation)
+        {
+            continue; // 已经取消或者替换掉的请求
+        }
+
+        Registration &reg = *found;
+        int res = cqe->res;
+        if (!(cqe->flags & IORING_CQE_F_MORE))
+        {
+            reg.armedEvents = 0; // 这个poll请求已经结束
+        }
+
+        if (res < 0)
+        {
+            // 错误交给channel的错误回调；fd本身失效(EBADF)时重新提交也只会再失败，
+            // 此时不再监听，等channel被remove；其余错误照常重新提交，避免连接挂死
+            if (res == -EBADF)
+            {
+                LOG_ERROR("io_uring poll fd=%d error:%d, stop polling \n", fd, -res);
+            }
+            else
+            {
+                LOG_ERROR("io_uring poll fd=%d error:%d, rearm \n", fd, -res);
+                if (reg.armedEvents == 0)
+                {
+                    rearmFds_.push_back(fd);
+                }
+            }
+            res = EPOLLERR;
+        }
+        else if (reg.armedEvents == 0)
+        {
+            rearmFds_.push_back(fd);
+        }
+
+        if (reg.activeRound != round_)
+        {
+            reg.activeRound = round_;
+            reg.revents = 0;
+            activeChannels->push_back(reg.channel);
+        }
+        reg.revents |= res; // POLLIN/POLLOUT等和EPOLLIN/EPOLLOUT的取值相同
+        reg.channel->set_revents(reg.revents);
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Poller.h"
+#include "Timestamp.h"
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include <linux/io_uring.h>
+
+class Channel;
+
+/**
+ * 基于io_uring的Poller，不依赖liburing，直接使用io_uring_setup/io_uring_enter系统调用
+ * 每个channel对应一个IORING_OP_POLL_ADD请求，poll()把本轮新提交的请求和等待完成合并成一次io_uring_enter
+ *
+ * io_uring的multishot poll是边沿触发的：数据没有读完时不会再产生新的完成事件，
+ * 而TcpConnection/Acceptor都依赖epoll的水平触发，所以普通channel使用单次poll，
+ * 每次完成后在下一次poll()中重新提交（提交时内核会立即检查一次就绪状态，效果等同于水平触发）；
+ * 关注了EPOLLET的channel使用multishot poll，只提交一次
+ *
+ * 另外支持完成模式的异步recv/sendmsg(asyncRecv/asyncSendmsg)，和poll请求共用同一个环，
+ * user_data最高位为1的是异步IO操作，其余的是poll请求
+ *
+ * 通过环境变量MUDUO_USE_IO_URING开启，内核不支持时newDefaultPoller退回epoll
+ */
+class IoUringPoller : public Poller
+{
+public:
+    // 内核不支持io_uring或者缺少需要的特性时返回nullptr
+    static IoUringPoller* newPoller(EventLoop *loop);
+    ~IoUringPoller() override;
+
+    // 重写基类Poller的抽象方法
+    Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
+    void updateChannel(Channel *channel) override;
+    void removeChannel(Channel *channel) override;
+
+    bool supportsEdgeTriggered() const override { return multishotSupported_; } // 单次poll只能做到水平触发
+    bool supportsAsyncIo() const override { return true; }
+    uint64_t asyncRecv(int fd, void *buf, size_t len, CompletionCallback cb) override;
+    uint64_t asyncSendmsg(int fd, const struct msghdr *msg, CompletionCallback cb) override;
+    void cancelAsyncIo(uint64_t id) override;
+
+private:
+    static const unsigned kRingEntries = 256;        // 提交队列长度
+    static const unsigned kCompletionEntries = 4096; // 完成队列长度
+    static const uint64_t kIgnoredUserData = ~0ULL;  // POLL_REMOVE请求自己的完成事件不需要处理
+    static const uint64_t kAsyncIoFlag = 1ULL << 63; // 异步IO操作的user_data
+    static const uint32_t kGenerationMask = 0x7fffffff; // poll请求的generation只用31位，不和kAsyncIoFlag冲突
+
+    // 每个fd上当前有效的poll请求
+    struct Registration
+    {
+        Channel *channel;
+        uint32_t generation; // 写进user_data，区分同一个fd先后提交的请求，旧请求的完成事件直接丢掉
+        uint32_t armedEvents; // 已经提交给内核的事件，0表示当前没有poll请求
+        bool multishot;
+        int revents;          // 本轮收集到的事件
+        uint64_t activeRound; // revents属于哪一轮poll
+    };
+    using AsyncIoMap = std::unordered_map<uint64_t, CompletionCallback>;
+
+    explicit IoUringPoller(EventLoop *loop);
+    bool init();
+    // 在一个已经可读的eventfd上提交一次multishot poll，完成事件带IORING_CQE_F_MORE才算支持，结果之后不再改变
+    bool probeMultishot();
+
+    io_uring_sqe* getSqe(); // 提交队列满了会先提交一次
+    int submitAndWait(unsigned waitNr, int timeoutMs);
+    void armPoll(int fd, Registration &reg);
+    void cancelPoll(int fd, Registration &reg);
+    // fd没有注册时返回nullptr
+    Registration* findRegistration(int fd)
+    {
+        return static_cast<size_t>(fd) < registrations_.size() && registrations_[fd].channel
+            ? &registrations_[fd] : nullptr;
+    }
+    uint32_t newGeneration();
+    uint64_t newAsyncIo(CompletionCallback cb);
+    // 收割完成队列，poll事件填到activeChannels，异步IO的完成放进completions
+    void fillActiveChannels(ChannelList *activeChannels);
+    void runCompletions(Timestamp now);
+
+    // 提交给内核的poll事件，去掉EPOLLET
+    static uint32_t pollEvents(const Channel *channel);
+    // 只有EPOLLET的channel才用multishot，其他channel需要水平触发语义
+    bool wantsMultishot(const Channel *channel) const;
+
+    static uint64_t makeUserData(int fd, uint32_t generation)
+    { return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd); }
+
+    int ringFd_;
+    bool multishotSupported_;
+
+    // 提交队列和完成队列都是和内核共享的内存
+    void *sqRing_;
+    size_t sqRingSize_;
+    void *cqRing_;
+    size_t cqRingSize_;
+    io_uring_sqe *sqes_;
+    size_t sqesSize_;
+
+    unsigned *sqHead_;
+    unsigned *sqTail_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    unsigned *sqArray_;
+    unsigned sqLocalTail_; // 已经填好的sqe的下一个位置，提交时才发布给内核
+
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned cqMask_;
+    io_uring_cqe *cqes_;
+
+    std::vector<Registration> registrations_; // 和channels_一样以fd为下标，channel为nullptr的位置没有注册
+    std::vector<int> rearmFds_; // 单次poll已经完成、需要在下一次poll()时重新提交的fd
+    uint32_t nextGeneration_;
+    uint64_t round_;
+
+    AsyncIoMap asyncIos_;  // 还没有完成的异步IO
+    uint64_t nextAsyncIo_;
+    std::vector<std::pair<CompletionCallback, int>> completions_; // 本轮完成的异步IO，收割完以后再执行
+};
\ No newline at end of file
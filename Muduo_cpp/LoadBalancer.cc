@@ -0,0 +1,175 @@
+#include "LoadBalancer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "Timestamp.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+
+// FNV-1a
+uint32_t hashBytes(const void *data, size_t len, uint32_t h = 2166136261u)
+{
+    const unsigned char *p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < len; ++i)
+    {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+class RoundRobinBalancer : public LoadBalancer
+{
+public:
+    RoundRobinBalancer(): next_(0) {}
+
+    EventLoop* select(const InetAddress&) override
+    {
+        EventLoop *loop = loops_[next_];
+        next_ = next_ + 1 < loops_.size() ? next_ + 1 : 0;
+        return loop;
+    }
+
+private:
+    size_t next_;
+};
+
+// 从上次选中的下一个开始扫描，负载相同的loop轮流被选中
+class LeastLoadBalancer : public LoadBalancer
+{
+public:
+    explicit LeastLoadBalancer(bool byPendingBytes): byPendingBytes_(byPendingBytes), start_(0) {}
+
+    EventLoop* select(const InetAddress&) override
+    {
+        const size_t n = loops_.size();
+        size_t best = start_;
+        std::pair<int64_t, int64_t> bestLoad = load(loops_[best]);
+        for (size_t i = 1; i < n; ++i)
+        {
+            size_t index = start_ + i < n ? start_ + i : start_ + i - n;
+            std::pair<int64_t, int64_t> l = load(loops_[index]);
+            if (l < bestLoad)
+            {
+                best = index;
+                bestLoad = l;
+            }
+        }
+        start_ = best + 1 < n ? best + 1 : 0;
+        return loops_[best];
+    }
+
+private:
+    std::pair<int64_t, int64_t> load(EventLoop *loop) const
+    {
+        if (byPendingBytes_)
+        {
+            return std::make_pair(loop->pendingOutputBytes(), loop->connectionCount());
+        }
+        return std::make_pair(loop->connectionCount(), int64_t(0));
+    }
+
+    const bool byPendingBytes_;
+    size_t start_;
+};
+
+class PowerOfTwoChoicesBalancer : public LoadBalancer
+{
+public:
+    PowerOfTwoChoicesBalancer(): seed_(static_cast<uint64_t>(Timestamp::now().microSecondsSinceEpoch()) | 1) {}
+
+    EventLoop* select(const InetAddress&) override
+    {
+        const size_t n = loops_.size();
+        if (n == 1)
+        {
+            return loops_[0];
+        }
+        size_t a = random() % n;
+        size_t b = random() % (n - 1);
+        if (b >= a)
+        {
+            ++b; // 保证两个不同
+        }
+        return load(loops_[b]) < load(loops_[a]) ? loops_[b] : loops_[a];
+    }
+
+private:
+    static int64_t load(EventLoop *loop)
+    {
+        return loop->connectionCount() * kBytesPerConnection + loop->pendingOutputBytes();
+    }
+
+    // xorshift64*
+    uint64_t random()
+    {
+        seed_ ^= seed_ >> 12;
+        seed_ ^= seed_ << 25;
+        seed_ ^= seed_ >> 27;
+        return (seed_ * 2685821657736338717ull) >> 32;
+    }
+
+    uint64_t seed_;
+};
+
+// 每个loop在环上放kVirtualNodes个虚拟节点，节点的哈希由loop的下标决定，同样的线程数重启后映射不变
+class ConsistentHashBalancer : public LoadBalancer
+{
+public:
+    static const int kVirtualNodes = 160;
+
+    void setLoops(const std::vector<EventLoop*> &loops) override
+    {
+        LoadBalancer::setLoops(loops);
+        ring_.clear();
+        for (size_t i = 0; i < loops.size(); ++i)
+        {
+            for (uint32_t v = 0; v < kVirtualNodes; ++v)
+            {
+                uint32_t key[2] = { static_cast<uint32_t>(i), v };
+                ring_.push_back(std::make_pair(hashBytes(key, sizeof key), loops[i]));
+            }
+        }
+        std::sort(ring_.begin(), ring_.end());
+    }
+
+    EventLoop* select(const InetAddress &peerAddr) override
+    {
+        // 只用IP，同一个客户端的不同端口落在同一个loop上
+        const in_addr &ip = peerAddr.getSockAddr()->sin_addr;
+        uint32_t h = hashBytes(&ip, sizeof ip);
+        auto it = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(h, static_cast<EventLoop*>(nullptr)));
+        if (it == ring_.end())
+        {
+            it = ring_.begin();
+        }
+        return it->second;
+    }
+
+private:
+    std::vector<std::pair<uint32_t, EventLoop*>> ring_;
+};
+
+} // namespace
+
+LoadBalancer* LoadBalancer::newLoadBalancer(Strategy strategy)
+{
+    switch (strategy)
+    {
+    case kLeastConnections:
+        return new LeastLoadBalancer(false);
+    case kLeastPendingBytes:
+        return new LeastLoadBalancer(true);
+    case kPowerOfTwoChoices:
+        return new PowerOfTwoChoicesBalancer;
+    case kConsistentHash:
+        return new ConsistentHashBalancer;
+    case kRoundRobin:
+    default:
+        return new RoundRobinBalancer;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <vector>
+
+class EventLoop;
+class InetAddress;
+
+/**
+ * 新连接分配给哪个subloop的策略，EventLoopThreadPool::getNextLoop(peerAddr)调用
+ *   kRoundRobin        : 轮询，和getNextLoop()相同
+ *   kLeastConnections  : 连接数最少的loop
+ *   kLeastPendingBytes : 发送队列中积压字节数最少的loop，相同时比较连接数
+ *   kPowerOfTwoChoices : 随机挑两个loop，取负载小的那个，负载 = 连接数 + 积压字节数/kBytesPerConnection，
+ *                        不需要扫描所有loop，也不会让所有新连接同时涌向同一个最空闲的loop
+ *   kConsistentHash    : 按对端IP做一致性哈希，同一个客户端的连接总是落在同一个loop上，利于按客户端缓存的数据的局部性
+ * 负载数据来自EventLoop::connectionCount和EventLoop::pendingOutputBytes，由各个loop线程更新，这里只是近似值
+ * select只在baseLoop线程中调用，实现不需要加锁
+ */
+class LoadBalancer : noncopyable
+{
+public:
+    enum Strategy
+    {
+        kRoundRobin,
+        kLeastConnections,
+        kLeastPendingBytes,
+        kPowerOfTwoChoices,
+        kConsistentHash,
+    };
+
+    static const int kBytesPerConnection = 64 * 1024; // 积压多少字节相当于多一个连接的负载
+
+    static LoadBalancer* newLoadBalancer(Strategy strategy);
+
+    virtual ~LoadBalancer() = default;
+
+    // EventLoopThreadPool::start中subloop创建完以后调用一次，loops非空
+    virtual void setLoops(const std::vector<EventLoop*> &loops) { loops_ = loops; }
+    // 为来自peerAddr的新连接选择一个loop
+    virtual EventLoop* select(const InetAddress &peerAddr) = 0;
+
+protected:
+    std::vector<EventLoop*> loops_;
+};
\ No newline at end of file
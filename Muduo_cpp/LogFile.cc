@@ -0,0 +1,134 @@
+#include "LogFile.h"
+
+#include <unistd.h>
+
+LogFile::LogFile(const std::string &basename,
+                off_t rollSize,
+                int flushInterval,
+                int checkEveryN)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , flushInterval_(flushInterval)
+    , checkEveryN_(checkEveryN)
+    , count_(0)
+    , startOfPeriod_(0)
+    , lastRoll_(0)
+    , lastFlush_(0)
+    , fp_(nullptr)
+    , writtenBytes_(0)
+{
+    rollFile();
+}
+
+LogFile::~LogFile()
+{
+    if (fp_)
+    {
+        ::fclose(fp_);
+    }
+}
+
+void LogFile::append(const char *logline, size_t len)
+{
+    if (fp_ == nullptr)
+    {
+        return;
+    }
+    size_t written = 0;
+    while (written != len)
+    {
+        size_t n = ::fwrite_unlocked(logline + written, 1, len - written, fp_);
+        if (n == 0)
+        {
+            int err = ::ferror(fp_);
+            if (err)
+            {
+                fprintf(stderr, "LogFile::append() failed, error:%d \n", err);
+            }
+            break;
+        }
+        written += n;
+    }
+    writtenBytes_ += written;
+
+    if (writtenBytes_ > rollSize_)
+    {
+        rollFile();
+    }
+    else if (++count_ >= checkEveryN_)
+    {
+        count_ = 0;
+        time_t now = ::time(nullptr);
+        time_t thisPeriod = now / kRollPerSeconds * kRollPerSeconds;
+        if (thisPeriod != startOfPeriod_)
+        {
+            rollFile();
+        }
+        else if (now - lastFlush_ > flushInterval_)
+        {
+            lastFlush_ = now;
+            flush();
+        }
+    }
+}
+
+void LogFile::flush()
+{
+    if (fp_)
+    {
+        ::fflush(fp_);
+    }
+}
+
+bool LogFile::rollFile()
+{
+    time_t now = 0;
+    std::string filename = getLogFileName(basename_, &now);
+    time_t start = now / kRollPerSeconds * kRollPerSeconds;
+
+    if (now > lastRoll_)
+    {
+        FILE *fp = ::fopen(filename.c_str(), "ae"); // e: O_CLOEXEC
+        if (fp == nullptr)
+        {
+            fprintf(stderr, "LogFile::rollFile() open %s failed \n", filename.c_str());
+            return false;
+        }
+        if (fp_)
+        {
+            ::fclose(fp_);
+        }
+        fp_ = fp;
+        ::setbuffer(fp_, buffer_, sizeof buffer_);
+        lastRoll_ = now;
+        lastFlush_ = now;
+        startOfPeriod_ = start;
+        writtenBytes_ = 0;
+        return true;
+    }
+    return false;
+}
+
+std::string LogFile::getLogFileName(const std::string &basename, time_t *now)
+{
+    std::string filename(basename);
+
+    char timebuf[32];
+    struct tm tm;
+    *now = ::time(nullptr);
+    ::gmtime_r(now, &tm);
+    strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S.", &tm);
+    filename += timebuf;
+
+    char hostname[256] = {0};
+    if (::gethostname(hostname, sizeof hostname - 1) != 0)
+    {
+        snprintf(hostname, sizeof hostname, "unknownhost");
+    }
+    filename += hostname;
+
+    char pidbuf[32];
+    snprintf(pidbuf, sizeof pidbuf, ".%d.log", ::getpid());
+    filename += pidbuf;
+    return filename;
+}
\ No newline at end of file
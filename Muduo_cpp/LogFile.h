@@ -0,0 +1,46 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * 滚动日志文件，只在AsyncLogging的后台线程中使用，不加锁
+ * 写满rollSize字节或者跨过零点时换一个新文件，文件名 basename.年月日-时分秒.主机名.pid.log
+ * 用fwrite_unlocked写进64K的用户态缓冲，每flushInterval秒fflush一次
+ */
+class LogFile : noncopyable
+{
+public:
+    LogFile(const std::string &basename,
+            off_t rollSize,
+            int flushInterval = 3,
+            int checkEveryN = 1024);
+    ~LogFile();
+
+    void append(const char *logline, size_t len);
+    void flush();
+    bool rollFile(); // 换一个新文件，同一秒内不会重复换
+
+private:
+    static std::string getLogFileName(const std::string &basename, time_t *now);
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int flushInterval_;
+    const int checkEveryN_; // 每写多少次检查一次是否跨天、是否需要flush，避免每次都取时间
+
+    int count_;
+    time_t startOfPeriod_; // 当前文件所在那一天的零点(UTC)
+    time_t lastRoll_;
+    time_t lastFlush_;
+
+    FILE *fp_;
+    off_t writtenBytes_;
+    char buffer_[64 * 1024];
+
+    static const int kRollPerSeconds = 60 * 60 * 24;
+};
\ No newline at end of file
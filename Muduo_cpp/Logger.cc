@@ -1,7 +1,58 @@
 #include "Logger.h"
 #include "Timestamp.h"
 
-#include <iostream>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// 和muduo一样，设置了环境变量MUDUO_LOG_DEBUG时从DEBUG级别开始输出
+static int initLogLevel()
+{
+    if (::getenv("MUDUO_LOG_DEBUG"))
+    {
+        return DEBUG;
+    }
+    return MUDUO_MIN_LOG_LEVEL > MUDUO_LOG_LEVEL_INFO ? MUDUO_MIN_LOG_LEVEL : MUDUO_LOG_LEVEL_INFO;
+}
+
+std::atomic<int> g_logLevel(initLogLevel());
+
+static void defaultOutput(const char *msg, int len)
+{
+    fwrite(msg, 1, len, stdout);
+}
+
+static void defaultFlush()
+{
+    fflush(stdout);
+}
+
+static Logger::OutputFunc g_output = defaultOutput;
+static Logger::FlushFunc g_flush = defaultFlush;
+
+// 每个线程缓存上一次格式化的 年/月/日 时:分:秒，同一秒内的日志只需要格式化微秒部分
+static __thread time_t t_lastSecond = 0;
+static __thread char t_time[32];
+static __thread int t_timeLen = 0;
+
+// 把now格式化成 2021/01/01 12:00:00.123456 写到buf，返回长度
+static int formatTime(Timestamp now, char *buf, size_t size)
+{
+    time_t seconds = now.secondsSinceEpoch();
+    if (seconds != t_lastSecond)
+    {
+        t_lastSecond = seconds;
+        struct tm tm_time;
+        localtime_r(&seconds, &tm_time);
+        t_timeLen = snprintf(t_time, sizeof t_time, "%4d/%02d/%02d %02d:%02d:%02d",
+            tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+            tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+    }
+    int microseconds = static_cast<int>(now.microSecondsSinceEpoch() % Timestamp::kMicroSecondsPerSecond);
+    memcpy(buf, t_time, t_timeLen);
+    return t_timeLen + snprintf(buf + t_timeLen, size - t_timeLen, ".%06d", microseconds);
+}
 
 // 获取日志唯一的实例对象
 Logger& Logger::instance()
@@ -11,32 +62,63 @@ Logger& Logger::instance()
 }
 
 // 设置 日志级别
-void Logger::setLogLevel(int level)
+void Logger::setLogLevel(LogLevel level)
 {
-    logLevel_ = level;
+    g_logLevel.store(level, std::memory_order_relaxed);
+}
+
+void Logger::setOutput(OutputFunc out)
+{
+    g_output = out;
+}
+
+void Logger::setFlush(FlushFunc flush)
+{
+    g_flush = flush;
 }
 
 // 写日志  [级别信息] time : msg
-void Logger::log(std::string msg)
+void Logger::log(LogLevel level, const char *fmt, ...)
 {
-    switch (logLevel_)
+    const char *levelName = "";
+    switch (level)
     {
     case INFO:
-        std::cout << "[INFO]";
+        levelName = "[INFO]";
         break;
     case ERROR:
-        std::cout << "[ERROR]";
+        levelName = "[ERROR]";
         break;
     case FATAL:
-        std::cout << "[FATAL]";
+        levelName = "[FATAL]";
         break;
     case DEBUG:
-        std::cout << "[DEBUG]";
+        levelName = "[DEBUG]";
         break;
     default:
         break;
     }
 
-    // 打印时间和msg
-    std::cout << Timestamp::now().toString() << " : " << msg << std::endl;
+    // 整行直接格式化到栈上的缓冲区，一次交给输出函数，消息部分最长1024字节
+    char buf[1280];
+    int len = snprintf(buf, sizeof buf, "%s", levelName);
+    len += formatTime(Timestamp::now(), buf + len, sizeof buf - len);
+    buf[len++] = ' ';
+    buf[len++] = ':';
+    buf[len++] = ' ';
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf + len, 1024, fmt, args);
+    va_end(args);
+    if (n > 0)
+    {
+        len += n < 1024 ? n : 1023; // 超长的消息被截断
+    }
+    buf[len++] = '\n';
+
+    g_output(buf, len);
+    if (level == FATAL)
+    {
+        g_flush();
+    }
 }
\ No newline at end of file
@@ -1,74 +1,96 @@
 #pragma once //防止头文件重复包含
 
+#include <stdlib.h>
+#include <atomic>
 #include <string>
 
 #include "noncopyable.h"
 
-// LOG_INFO("%s %d", arg1, arg2)
-#define LOG_INFO(logmsgFormat, ...) \
-    do \
-    { \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(INFO); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    } while(0) 
+// 编译期的日志级别下限，低于它的LOG_XXX直接展开成空语句，参数也不会求值
+// 可以在编译选项里用 -DMUDUO_MIN_LOG_LEVEL=1 这样指定，数值和下面的LogLevel一致
+// 没有指定时沿用原来的约定：定义了MUDEBUG才编译LOG_DEBUG
+#define MUDUO_LOG_LEVEL_DEBUG 0
+#define MUDUO_LOG_LEVEL_INFO 1
+#define MUDUO_LOG_LEVEL_ERROR 2
+#define MUDUO_LOG_LEVEL_FATAL 3
 
-#define LOG_ERROR(logmsgFormat, ...) \
-    do \
-    { \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(ERROR); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    } while(0) 
-
-#define LOG_FATAL(logmsgFormat, ...) \
-    do \
-    { \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(FATAL); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-        exit(-1); \
-    } while(0) 
-
-#ifdef MUDEBUG //使用宏打开，如果定义了MUDEBUG，则执行，否则不执行
-#define LOG_DEBUG(logmsgFormat, ...) \
-    do \
-    { \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(DEBUG); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    } while(0) 
+#ifndef MUDUO_MIN_LOG_LEVEL
+#ifdef MUDEBUG
+#define MUDUO_MIN_LOG_LEVEL MUDUO_LOG_LEVEL_DEBUG
 #else
-    #define LOG_DEBUG(logmsgFormat, ...)
+#define MUDUO_MIN_LOG_LEVEL MUDUO_LOG_LEVEL_INFO
+#endif
 #endif
 
-// 定义日志的级别  INFO  ERROR  FATAL  DEBUG 
+// 定义日志的级别  DEBUG  INFO  ERROR  FATAL，从低到高
 enum LogLevel
 {
-    INFO,  // 普通信息
-    ERROR, // 错误信息
-    FATAL, // core信息
-    DEBUG, // 调试信息
+    DEBUG = MUDUO_LOG_LEVEL_DEBUG, // 调试信息
+    INFO = MUDUO_LOG_LEVEL_INFO,   // 普通信息
+    ERROR = MUDUO_LOG_LEVEL_ERROR, // 错误信息
+    FATAL = MUDUO_LOG_LEVEL_FATAL, // core信息
 };
 
+// 运行期的日志级别下限，各个线程的LOG_XXX先读它，级别不够就直接跳过，不做任何格式化
+extern std::atomic<int> g_logLevel;
+
 // 输出一个日志类
 class Logger : noncopyable //定义为不可拷贝的类
 {
 public:
+    using OutputFunc = void (*)(const char *msg, int len);
+    using FlushFunc = void (*)();
+
     // 获取日志唯一的实例对象
     static Logger& instance();
-    // 设置日志级别
-    void setLogLevel(int level);
-    // 写日志
-    void log(std::string msg);
-private:
-    int logLevel_;
-};
\ No newline at end of file
+
+    // 运行期日志级别，默认是INFO，设置了环境变量MUDUO_LOG_DEBUG时是DEBUG
+    // 定义了MUDEBUG只是把LOG_DEBUG编译进来，还需要在运行期打开DEBUG级别才会输出
+    static LogLevel logLevel() { return static_cast<LogLevel>(g_logLevel.load(std::memory_order_relaxed)); }
+    static void setLogLevel(LogLevel level);
+
+    // 写一条level级别的日志，级别跟着每条日志传进来，不修改共享的状态，多个线程可以同时调用
+    void log(LogLevel level, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+    // 设置格式化好的日志行的去处，默认写到stdout，不逐行刷新
+    // 使用AsyncLogging时，在输出函数中调用AsyncLogging::append，io线程就不会阻塞在磁盘写上
+    static void setOutput(OutputFunc out);
+    // LOG_FATAL退出进程之前调用
+    static void setFlush(FlushFunc flush);
+};
+
+#define MUDUO_LOG_IF(level, logmsgFormat, ...) \
+    do \
+    { \
+        if (__builtin_expect(Logger::logLevel() <= (level), 0)) \
+        { \
+            Logger::instance().log(level, logmsgFormat, ##__VA_ARGS__); \
+        } \
+    } while(0)
+
+// LOG_INFO("%s %d", arg1, arg2)
+#if MUDUO_MIN_LOG_LEVEL <= MUDUO_LOG_LEVEL_INFO
+#define LOG_INFO(logmsgFormat, ...) MUDUO_LOG_IF(INFO, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_INFO(logmsgFormat, ...) do {} while(0)
+#endif
+
+#if MUDUO_MIN_LOG_LEVEL <= MUDUO_LOG_LEVEL_ERROR
+#define LOG_ERROR(logmsgFormat, ...) MUDUO_LOG_IF(ERROR, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(logmsgFormat, ...) do {} while(0)
+#endif
+
+// FATAL不受级别限制，总是输出并退出进程
+#define LOG_FATAL(logmsgFormat, ...) \
+    do \
+    { \
+        Logger::instance().log(FATAL, logmsgFormat, ##__VA_ARGS__); \
+        exit(-1); \
+    } while(0) 
+
+#if MUDUO_MIN_LOG_LEVEL <= MUDUO_LOG_LEVEL_DEBUG
+#define LOG_DEBUG(logmsgFormat, ...) MUDUO_LOG_IF(DEBUG, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(logmsgFormat, ...) do {} while(0)
+#endif
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <utility>
+
+/**
+ * 无锁的多生产者单消费者队列（Dmitry Vyukov的侵入式MPSC队列）
+ * 生产者push只有一次原子exchange和一次store，不会互相阻塞；消费者pop不需要任何原子读改写操作
+ * 用于EventLoop的pendingFunctors_：任意线程都可以push，只有loop所在的线程pop
+ *
+ * 注意：生产者在exchange之后、链接next之前被调度走时，它后面的节点暂时不可见，
+ * 这时pop会返回false，即使队列中还有数据，调用者需要结合计数自己决定是否重试
+ */
+template <typename T>
+class MpscQueue : noncopyable
+{
+public:
+    MpscQueue()
+        : head_(&stub_)
+        , tail_(&stub_)
+    {}
+
+    ~MpscQueue()
+    {
+        T value;
+        while (pop(&value)) {}
+    }
+
+    // 任意线程调用
+    void push(T value)
+    {
+        pushNode(new Node(std::move(value)));
+    }
+
+    // 只能在消费者线程调用，取出一个元素返回true
+    bool pop(T *value)
+    {
+        Node *tail = tail_;
+        Node *next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_) // 跳过哨兵节点
+        {
+            if (next == nullptr)
+            {
+                return false;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next != nullptr)
+        {
+            tail_ = next;
+            *value = std::move(tail->value);
+            delete tail;
+            return true;
+        }
+
+        Node *head = head_.load(std::memory_order_acquire);
+        if (tail != head) // 有生产者正在push，还没有链接到tail上
+        {
+            return false;
+        }
+
+        // tail是最后一个节点，重新放入哨兵，这样tail就可以被取出
+        pushNode(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next != nullptr)
+        {
+            tail_ = next;
+            *value = std::move(tail->value);
+            delete tail;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    struct Node
+    {
+        Node(): next(nullptr) {}
+        explicit Node(T v): next(nullptr), value(std::move(v)) {}
+
+        std::atomic<Node*> next;
+        T value;
+    };
+
+    void pushNode(Node *node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node *prev = head_.exchange(node, std::memory_order_acq_rel); // 生产者之间的唯一同步点
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    std::atomic<Node*> head_; // 生产者从head_端插入
+    Node *tail_;              // 消费者从tail_端取出，只有消费者线程访问
+    Node stub_;               // 哨兵节点
+};
\ No newline at end of file
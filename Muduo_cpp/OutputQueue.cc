@@ -0,0 +1,275 @@
+#include "OutputQueue.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <algorithm>
+
+OutputQueue::OutputQueue()
+    : readableBytes_(0)
+    , byteCounter_(nullptr)
+    , pipeEmpty_(false)
+{
+}
+
+OutputQueue::~OutputQueue()
+{
+    retrieveAll(); // 关闭还没发送完的kFile/kPipe片段持有的fd
+}
+
+void OutputQueue::setBlockPool(BlockPool *pool)
+{
+    chain_.reset(pool ? new ChainBuffer(pool) : nullptr);
+}
+
+void OutputQueue::setByteCounter(std::atomic<int64_t> *counter)
+{
+    byteCounter_ = counter;
+}
+
+void OutputQueue::addBytes(int64_t delta)
+{
+    readableBytes_ += delta;
+    if (byteCounter_)
+    {
+        byteCounter_->fetch_add(delta, std::memory_order_relaxed);
+    }
+}
+
+void OutputQueue::append(const char *data, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    if (chain_)
+    {
+        chain_->append(data, len);
+    }
+    else
+    {
+        buffer_.append(data, len);
+    }
+    // 连续的拷贝合并成一个片段
+    if (slices_.empty() || slices_.back().kind != Slice::kCopy)
+    {
+        slices_.push_back(Slice(Slice::kCopy));
+    }
+    slices_.back().len += len;
+    addBytes(static_cast<int64_t>(len));
+}
+
+void OutputQueue::append(std::string &&data, size_t offset)
+{
+    if (offset >= data.size())
+    {
+        return;
+    }
+    slices_.push_back(Slice(Slice::kString));
+    Slice &slice = slices_.back();
+    slice.str = std::move(data);
+    slice.offset = offset;
+    slice.len = slice.str.size() - offset;
+    addBytes(static_cast<int64_t>(slice.len));
+}
+
+void OutputQueue::append(const std::shared_ptr<const std::string> &data, size_t offset)
+{
+    if (!data || offset >= data->size())
+    {
+        return;
+    }
+    slices_.push_back(Slice(Slice::kShared));
+    Slice &slice = slices_.back();
+    slice.shared = data;
+    slice.offset = offset;
+    slice.len = data->size() - offset;
+    addBytes(static_cast<int64_t>(slice.len));
+}
+
+void OutputQueue::appendFile(int fd, off_t offset, size_t len)
+{
+    if (len == 0)
+    {
+        ::close(fd);
+        return;
+    }
+    slices_.push_back(Slice(Slice::kFile));
+    Slice &slice = slices_.back();
+    slice.fd = fd;
+    slice.offset = offset;
+    slice.len = len;
+    addBytes(static_cast<int64_t>(len));
+}
+
+void OutputQueue::appendPipe(int fd, size_t len)
+{
+    if (len == 0)
+    {
+        ::close(fd);
+        return;
+    }
+    slices_.push_back(Slice(Slice::kPipe));
+    Slice &slice = slices_.back();
+    slice.fd = fd;
+    slice.len = len;
+    addBytes(static_cast<int64_t>(len));
+}
+
+ssize_t OutputQueue::writeFd(int fd, int *saveErrno)
+{
+    pipeEmpty_ = false;
+    if (!slices_.empty()
+        && (slices_.front().kind == Slice::kFile || slices_.front().kind == Slice::kPipe))
+    {
+        return writeFile(fd, saveErrno);
+    }
+
+    struct iovec vec[IOV_MAX];
+    int iovcnt = peekIovecs(vec, IOV_MAX);
+
+    ssize_t n = ::writev(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    return n;
+}
+
+int OutputQueue::peekIovecs(struct iovec *vec, int maxIovecs) const
+{
+    int iovcnt = 0;
+    size_t copySkip = 0; // 前面的kCopy片段在存储区中占用的字节数
+
+    for (const Slice &slice : slices_)
+    {
+        if (iovcnt >= maxIovecs || slice.kind == Slice::kFile || slice.kind == Slice::kPipe)
+        {
+            break; // 文件和管道的数据不在内存中，等前面的片段写完再单独发送
+        }
+        switch (slice.kind)
+        {
+        case Slice::kCopy:
+            if (chain_)
+            {
+                iovcnt += chain_->peekIovecs(copySkip, slice.len, vec + iovcnt, maxIovecs - iovcnt);
+            }
+            else
+            {
+                vec[iovcnt].iov_base = const_cast<char*>(buffer_.peek() + copySkip);
+                vec[iovcnt].iov_len = slice.len;
+                ++iovcnt;
+            }
+            copySkip += slice.len;
+            break;
+        case Slice::kString:
+            vec[iovcnt].iov_base = const_cast<char*>(slice.str.data() + slice.offset);
+            vec[iovcnt].iov_len = slice.len;
+            ++iovcnt;
+            break;
+        case Slice::kShared:
+            vec[iovcnt].iov_base = const_cast<char*>(slice.shared->data() + slice.offset);
+            vec[iovcnt].iov_len = slice.len;
+            ++iovcnt;
+            break;
+        default:
+            break;
+        }
+    }
+    return iovcnt;
+}
+
+ssize_t OutputQueue::writeFile(int sockfd, int *saveErrno)
+{
+    Slice &slice = slices_.front();
+    ssize_t n;
+    if (slice.kind == Slice::kFile)
+    {
+        off_t offset = static_cast<off_t>(slice.offset);
+        n = ::sendfile(sockfd, slice.fd, &offset, slice.len);
+    }
+    else
+    {
+        n = ::splice(slice.fd, nullptr, sockfd, nullptr, slice.len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    }
+
+    if (n < 0)
+    {
+        *saveErrno = errno;
+        if (slice.kind == Slice::kPipe && errno == EAGAIN)
+        {
+            // SPLICE_F_NONBLOCK时管道为空和socket满了都返回EAGAIN，管道中没有数据说明是前者
+            // (写端已经关闭的空管道splice返回0，不会走到这里)
+            int pending = 0;
+            pipeEmpty_ = ::ioctl(slice.fd, FIONREAD, &pending) == 0 && pending == 0;
+        }
+    }
+    else if (n == 0)
+    {
+        // 文件比指定的区间短，或者管道写端已经关闭，剩下的数据永远等不到了
+        LOG_ERROR("OutputQueue::writeFile fd=%d reached EOF with %lu bytes left \n", slice.fd, slice.len);
+        addBytes(-static_cast<int64_t>(slice.len));
+        popFront();
+    }
+    return n;
+}
+
+void OutputQueue::popFront()
+{
+    if (slices_.front().fd >= 0)
+    {
+        ::close(slices_.front().fd);
+    }
+    slices_.pop_front(); // kString/kShared持有的数据在这里释放
+}
+
+void OutputQueue::retrieve(size_t len)
+{
+    len = std::min(len, readableBytes_);
+    addBytes(-static_cast<int64_t>(len));
+    while (len > 0)
+    {
+        Slice &slice = slices_.front();
+        size_t n = std::min(len, slice.len);
+        if (slice.kind == Slice::kCopy)
+        {
+            if (chain_)
+            {
+                chain_->retrieve(n);
+            }
+            else
+            {
+                buffer_.retrieve(n);
+            }
+        }
+        else
+        {
+            slice.offset += n;
+        }
+        slice.len -= n;
+        len -= n;
+        if (slice.len == 0)
+        {
+            popFront(); // 片段发送完
+        }
+    }
+}
+
+void OutputQueue::retrieveAll()
+{
+    while (!slices_.empty())
+    {
+        popFront();
+    }
+    addBytes(-static_cast<int64_t>(readableBytes_));
+    buffer_.retrieveAll();
+    if (chain_)
+    {
+        chain_->retrieveAll();
+    }
+}
\ No newline at end of file
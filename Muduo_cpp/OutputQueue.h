@@ -0,0 +1,86 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Buffer.h"
+#include "ChainBuffer.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * TcpConnection的发送队列，由按顺序排列的若干片段(Slice)组成：
+ *   kCopy   : 调用者的数据只能拷贝，拷进Buffer（或开启ChainBuffer时拷进池化的块链），片段只记录长度
+ *   kString : 调用者移交所有权的std::string，不拷贝
+ *   kShared : 多个连接共享的只读数据，不拷贝
+ *   kFile   : 文件的一段区间，用sendfile直接从page cache发送，数据不经过用户态
+ *   kPipe   : 管道中的数据，用splice直接搬到socket，做代理时不经过用户态
+ * 可写时用一次writev把队列前面最多IOV_MAX个内存片段一起发出去，队头是kFile/kPipe时单独调用一次sendfile/splice，
+ * 大块数据不再需要先拷进发送缓冲区，大量小响应排队时也只需要一次系统调用
+ * 只在连接所属的loop线程中使用
+ */
+class OutputQueue : noncopyable
+{
+public:
+    OutputQueue();
+    ~OutputQueue();
+
+    // kCopy的数据改为存放在pool的块链中，必须在队列为空时调用
+    void setBlockPool(BlockPool *pool);
+    // 队列字节数的变化同时累加到counter上(loop的待发送字节数)，必须在队列为空时调用
+    void setByteCounter(std::atomic<int64_t> *counter);
+
+    size_t readableBytes() const { return readableBytes_; }
+    size_t numSlices() const { return slices_.size(); }
+
+    void append(const char *data, size_t len);                     // 拷贝
+    void append(std::string &&data, size_t offset = 0);            // 接管data，从offset开始发送
+    void append(const std::shared_ptr<const std::string> &data, size_t offset = 0); // 共享，不拷贝
+    // 下面两个接管fd，片段发送完或者清空队列时close
+    void appendFile(int fd, off_t offset, size_t len); // 文件从offset开始的len字节
+    void appendPipe(int fd, size_t len);               // 管道读端中的len字节
+
+    // 把队列前面的内存片段填进vec，最多maxIovecs个，遇到kFile/kPipe片段就停下，返回填了几个
+    // 返回0并且队列不空说明队头是kFile/kPipe
+    int peekIovecs(struct iovec *vec, int maxIovecs) const;
+
+    // 一次writev(或sendfile/splice)发送队列前面的片段，返回值和errno的处理与Buffer::writeFd相同，由调用者retrieve
+    // 文件或管道提前读到末尾时，丢弃这个片段剩下的长度并返回0
+    ssize_t writeFd(int fd, int *saveErrno);
+    // 上一次writeFd返回EAGAIN是因为队头的管道暂时为空(而不是socket发送缓冲区满了)时返回管道fd，否则返回-1
+    // 这时等EPOLLOUT没有用，应该等管道可读
+    int emptyPipeFd() const { return pipeEmpty_ ? slices_.front().fd : -1; }
+
+    void retrieve(size_t len);
+    void retrieveAll();
+
+private:
+    struct Slice
+    {
+        enum Kind { kCopy, kString, kShared, kFile, kPipe };
+
+        explicit Slice(Kind k): kind(k), len(0), offset(0), fd(-1) {}
+
+        Kind kind;
+        size_t len;    // 还没有发送的字节数
+        size_t offset; // kString/kShared/kFile已经发送到的位置
+        int fd;        // kFile/kPipe持有的fd
+        std::string str;
+        std::shared_ptr<const std::string> shared;
+    };
+
+    ssize_t writeFile(int sockfd, int *saveErrno);
+    void popFront();
+    void addBytes(int64_t delta);
+
+    std::deque<Slice> slices_;
+    size_t readableBytes_;
+    std::atomic<int64_t> *byteCounter_;
+    bool pipeEmpty_;
+
+    // kCopy片段的数据按顺序存放在这里，队头的kCopy片段总是对应存储区最前面的数据
+    Buffer buffer_;
+    std::unique_ptr<ChainBuffer> chain_;
+};
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include "PollPoller.h"
+#include "Logger.h"
+#include "Channel.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <algorithm>
+
+// channel未添加到poller中
+const int kNew = -1;
+
+PollPoller::PollPoller(EventLoop *loop): Poller(loop), scanStart_(0) {}
+
+PollPoller::~PollPoller() {}
+
+Timestamp PollPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+    LOG_DEBUG("func=%s => fd total count:%lu \n", __FUNCTION__, channels_.size());
+
+    int numEvents = ::poll(pollfds_.data(), pollfds_.size(), timeoutMs);
+    int saveErrno = errno;
+    Timestamp now(Timestamp::now());
+
+    if (numEvents > 0)
+    {
+        LOG_DEBUG("%d events happened \n", numEvents);
+        fillActiveChannels(numEvents, activeChannels);
+    }
+    else if (numEvents == 0)
+    {
+        LOG_DEBUG("%s timeout! \n", __FUNCTION__);
+    }
+    else if (saveErrno != EINTR)
+    {
+        errno = saveErrno;
+        LOG_ERROR("PollPoller::poll() err!");
+    }
+    return now;
+}
+
+// 依次扫描pollfds_，找够numEvents个就绪的fd就停下
+void PollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels)
+{
+    const size_t size = pollfds_.size();
+    int budget = maxEventsPerPoll_ > 0 ? maxEventsPerPoll_ : numEvents;
+    size_t start = scanStart_ < size ? scanStart_ : 0;
+    for (size_t i = 0; i < size && numEvents > 0 && budget > 0; ++i)
+    {
+        size_t index = start + i < size ? start + i : start + i - size;
+        const struct pollfd &pfd = pollfds_[index];
+        if (pfd.revents > 0)
+        {
+            --numEvents;
+            --budget;
+            Channel *channel = channels_.find(pfd.fd);
+            channel->set_revents(pfd.revents); // POLLIN/POLLOUT等和EPOLLIN/EPOLLOUT的取值相同
+            activeChannels->push_back(channel);
+            scanStart_ = index + 1; // 没处理的fd仍然就绪，下一次poll从这里之后开始
+        }
+    }
+}
+
+void PollPoller::updateChannel(Channel *channel)
+{
+    const int fd = channel->fd();
+    LOG_DEBUG("func=%s => fd=%d events=%d index=%d \n", __FUNCTION__, fd, channel->events(), channel->index());
+
+    // 只有低16位是poll的事件，EPOLLET被截掉
+    short events = static_cast<short>(channel->events());
+    if (channel->index() == kNew)
+    {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = events;
+        pfd.revents = 0;
+        pollfds_.push_back(pfd);
+        channel->set_index(static_cast<int>(pollfds_.size()) - 1);
+        channels_.add(fd, channel);
+    }
+    else
+    {
+        struct pollfd &pfd = pollfds_[channel->index()];
+        pfd.events = events;
+        pfd.revents = 0;
+        pfd.fd = channel->isNoneEvent() ? -fd - 1 : fd; // 负的fd会被poll忽略，位置保留着
+    }
+}
+
+void PollPoller::removeChannel(Channel *channel)
+{
+    const int fd = channel->fd();
+    LOG_DEBUG("func=%s => fd=%d\n", __FUNCTION__, fd);
+
+    const int index = channel->index();
+    channels_.erase(fd);
+    if (index == kNew)
+    {
+        return;
+    }
+
+    // 和最后一个元素交换再pop_back，被换过来的channel要更新index
+    if (static_cast<size_t>(index) != pollfds_.size() - 1)
+    {
+        std::iter_swap(pollfds_.begin() + index, pollfds_.end() - 1);
+        int movedFd = pollfds_[index].fd;
+        if (movedFd < 0)
+        {
+            movedFd = -movedFd - 1;
+        }
+        channels_.find(movedFd)->set_index(index);
+    }
+    pollfds_.pop_back();
+    channel->set_index(kNew);
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Poller.h"
+#include "Timestamp.h"
+
+#include <vector>
+
+struct pollfd;
+
+class Channel;
+
+/**
+ * 基于poll(2)的Poller，通过环境变量MUDUO_USE_POLL开启
+ * 所有关注的fd放在一个紧凑的pollfd数组中，每次poll把整个数组交给内核，没有epoll_ctl，
+ * 只有几十个很活跃的fd时往往比epoll更省
+ *
+ * channel的index_是它在pollfds_中的下标，-1表示还没有添加(和EPollPoller的kNew相同)
+ * 对任何事件都不感兴趣的channel保留位置，把fd改成-fd-1让poll忽略它
+ * 删除时把最后一个元素换到被删除的位置，数组始终保持紧凑
+ *
+ * poll没有边沿触发，关注了EPOLLET的channel按水平触发处理
+ */
+class PollPoller : public Poller
+{
+public:
+    PollPoller(EventLoop *loop);
+    ~PollPoller() override;
+
+    // 重写基类Poller的抽象方法
+    Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
+    void updateChannel(Channel *channel) override;
+    void removeChannel(Channel *channel) override;
+
+    bool supportsEdgeTriggered() const override { return false; }
+
+private:
+    // 填写活跃的连接，有maxEventsPerPoll_限制时从上次停下的位置接着扫描，排在后面的fd不会被饿死
+    void fillActiveChannels(int numEvents, ChannelList *activeChannels);
+
+    using PollFdList = std::vector<struct pollfd>;
+    PollFdList pollfds_;
+    size_t scanStart_; // 下一次从pollfds_的这个位置开始扫描
+};
\ No newline at end of file
@@ -1,9 +1,30 @@
 #include "Poller.h"
 #include "Channel.h"
 
-Poller::Poller(EventLoop *loop): ownerLoop_(loop){}
+#include <algorithm>
+
+Poller::Poller(EventLoop *loop): ctlCalls_(0), ctlElided_(0), maxEventsPerPoll_(0), ownerLoop_(loop){}
 
 bool Poller::hasChannel(Channel *channel) const{ //判断channel在poller是否存在
-    auto it = channels_.find(channel->fd()); //查找sockfd，也就找到了对应的channel
-    return it != channels_.end() && it->second == channel;
+    return channels_.find(channel->fd()) == channel; //查找sockfd，也就找到了对应的channel
+}
+
+void Poller::ChannelMap::add(int fd, Channel *channel){
+    size_t index = static_cast<size_t>(fd);
+    if (index >= table_.size()){
+        // 按倍数增长，fd逐个增加时不会每次都重新分配
+        table_.resize(std::max(index + 1, table_.size() * 2), nullptr);
+    }
+    if (table_[index] == nullptr){
+        ++size_;
+    }
+    table_[index] = channel;
+}
+
+void Poller::ChannelMap::erase(int fd){
+    size_t index = static_cast<size_t>(fd);
+    if (index < table_.size() && table_[index] != nullptr){
+        table_[index] = nullptr;
+        --size_;
+    }
 }
\ No newline at end of file
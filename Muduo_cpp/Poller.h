@@ -3,8 +3,13 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 
+#include <atomic>
+#include <functional>
 #include <vector>
-#include <unordered_map>
+#include <stdint.h>
+#include <stddef.h>
+
+struct msghdr;
 
 class Channel;
 class EventLoop;
@@ -26,16 +31,62 @@ public:
     // 判断一个Poller当中是否有这个channel
     bool hasChannel(Channel *channel) const;
 
+    // EPollPoller实际调用epoll_ctl的次数，以及因为合并或者没有净变化而省掉的次数，可以在任意线程读取
+    int64_t controlCalls() const { return ctlCalls_.load(std::memory_order_relaxed); }
+    int64_t elidedControlCalls() const { return ctlElided_.load(std::memory_order_relaxed); }
+
+    // 每次poll最多返回多少个活跃channel，0表示不限制，只能在loop线程中调用
+    // 一轮循环处理完活跃channel才会执行doPendingFunctors，限制以后突发的连接/读事件不会把跨线程任务和定时器饿死，
+    // 没有返回的事件留在内核中，下一轮poll再处理
+    void setMaxEventsPerPoll(int maxEvents) { maxEventsPerPoll_ = maxEvents > 0 ? maxEvents : 0; }
+    int maxEventsPerPoll() const { return maxEventsPerPoll_; }
+
+    // 是否支持EPOLLET边沿触发，不支持时关注了EPOLLET的channel按水平触发处理
+    virtual bool supportsEdgeTriggered() const { return true; }
+
+    // 完成模式的异步IO，目前只有IoUringPoller支持
+    // res是对应系统调用的返回值，出错时是-errno，被取消时是-ECANCELED
+    // 回调在poll()收割完完成队列之后、返回之前在loop线程中执行
+    using CompletionCallback = std::function<void(int res, Timestamp completionTime)>;
+    virtual bool supportsAsyncIo() const { return false; }
+    // 提交recv/sendmsg，返回操作id，buf和msg指向的内存在完成之前必须保持有效
+    virtual uint64_t asyncRecv(int /*fd*/, void * /*buf*/, size_t /*len*/, CompletionCallback /*cb*/) { return 0; }
+    virtual uint64_t asyncSendmsg(int /*fd*/, const struct msghdr * /*msg*/, CompletionCallback /*cb*/) { return 0; }
+    // 取消还没有完成的操作，回调仍然会被调用一次
+    virtual void cancelAsyncIo(uint64_t /*id*/) {}
+
     // EventLoop可以通过该接口获取默认的IO复用的具体实现，poll和epoll都可以
     static Poller* newDefaultPoller(EventLoop *loop);
 
 protected:
-    // unordered_map的key：sockfd  value：sockfd所属的channel通道类型的指针
-    // unordered_map < sockfd，fd对应的channel >  
+    /**
+     * 文件描述符 -> Channel的映射，以fd为下标的稠密表
+     * fd总是内核分配的最小可用整数，所以表很紧凑，查找只是一次数组下标访问，没有哈希，
+     * 增删也不分配节点，连接风暴时不会有频繁的内存分配；表只增长不收缩
+     */
+    class ChannelMap
+    {
+    public:
+        ChannelMap(): size_(0) {}
+
+        Channel* find(int fd) const
+        { return static_cast<size_t>(fd) < table_.size() ? table_[fd] : nullptr; }
+        void add(int fd, Channel *channel);
+        void erase(int fd);
+        size_t size() const { return size_; } // 注册的channel个数
+
+    private:
+        std::vector<Channel*> table_; // 没有channel的位置是nullptr
+        size_t size_;
+    };
+
     // 当poller检测到某个套接字有事件发生时，通过文件描述符可以直接找到Channel,Channel里面有读回调写回调
-    using ChannelMap = std::unordered_map<int, Channel*>;
     ChannelMap channels_;  // 记录 文件描述符 -> Channel的映射，也帮忙保管所有注册在你这个Poller上的Channel
 
+    std::atomic<int64_t> ctlCalls_;
+    std::atomic<int64_t> ctlElided_;
+    int maxEventsPerPoll_;
+
 private:
     EventLoop *ownerLoop_; // 定义当前的Poller所属的事件循环EventLoop
 };
\ No newline at end of file
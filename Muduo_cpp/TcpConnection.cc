@@ -8,9 +8,11 @@
 #include <errno.h>
 #include <sys/types.h>         
 #include <sys/socket.h>
+#include <string.h>
 #include <strings.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <unistd.h>
 #include <string>
 
 static EventLoop* CheckLoopNotNull(EventLoop *loop)
@@ -26,9 +28,33 @@ TcpConnection::TcpConnection(EventLoop *loop,
                 const std::string &nameArg, 
                 int sockfd,
                 const InetAddress& localAddr,
-                const InetAddress& peerAddr)
+                const InetAddress& peerAddr,
+                uint64_t id)
+    : TcpConnection(loop, nameArg, nullptr, sockfd, localAddr, peerAddr, id)
+{
+}
+
+TcpConnection::TcpConnection(EventLoop *loop,
+                const std::shared_ptr<const std::string> &namePrefix,
+                int sockfd,
+                const InetAddress& localAddr,
+                const InetAddress& peerAddr,
+                uint64_t id)
+    : TcpConnection(loop, std::string(), namePrefix, sockfd, localAddr, peerAddr, id)
+{
+}
+
+TcpConnection::TcpConnection(EventLoop *loop,
+                const std::string &nameArg,
+                const std::shared_ptr<const std::string> &namePrefix,
+                int sockfd,
+                const InetAddress& localAddr,
+                const InetAddress& peerAddr,
+                uint64_t id)
     : loop_(CheckLoopNotNull(loop))
+    , namePrefix_(namePrefix)
     , name_(nameArg)
+    , id_(id)
     , state_(kConnecting)
     , reading_(true)
     , socket_(new Socket(sockfd))
@@ -36,6 +62,15 @@ TcpConnection::TcpConnection(EventLoop *loop,
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
     , highWaterMark_(64*1024*1024) // 64M
+    , useChainOutputBuffer_(false)
+    , autoCork_(false)
+    , corkFlushPending_(false)
+    , edgeTriggered_(false)
+    , writeBlocked_(false)
+    , waitingForPipe_(false)
+    , completionIo_(false)
+    , recvOp_(0)
+    , sendOp_(0)
 {
     // 下面给channel设置相应的回调函数，poller给channel通知感兴趣的事件发生了，channel会回调相应的操作函数
     channel_->setReadCallback(
@@ -51,15 +86,30 @@ TcpConnection::TcpConnection(EventLoop *loop,
         std::bind(&TcpConnection::handleError, this)
     );
 
-    LOG_INFO("TcpConnection::ctor[%s] at fd=%d\n", name_.c_str(), sockfd);
+    LOG_INFO("TcpConnection::ctor[%s] id=%llu at fd=%d\n",
+        namePrefix_ ? namePrefix_->c_str() : name_.c_str(), static_cast<unsigned long long>(id_), sockfd);
     socket_->setKeepAlive(true);
+
+    // 构造时(baseLoop分配连接时)就计入loop的负载，同一批连接的后面几个能看到前面的分配结果
+    loop_->addConnectionCount(1);
+    outputQueue_.setByteCounter(loop_->pendingOutputBytesCounter());
 }
 
 
 TcpConnection::~TcpConnection()
 {
     LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d \n", 
-        name_.c_str(), channel_->fd(), (int)state_);
+        name().c_str(), channel_->fd(), (int)state_);
+}
+
+const std::string& TcpConnection::name() const
+{
+    if (namePrefix_)
+    {
+        // 可能在多个线程中第一次调用
+        std::call_once(nameOnce_, [this]() { name_ = *namePrefix_ + '#' + std::to_string(id_); });
+    }
+    return name_;
 }
 
 void TcpConnection::send(const std::string &buf)
@@ -77,25 +127,210 @@ void TcpConnection::send(const std::string &buf)
         }
         else
         {
+            // 不能只绑定buf.c_str()，调用者的buf在回调执行前可能已经释放，拷贝一份交给回调持有
+            loop_->runInLoop(std::bind(
+                &TcpConnection::sendStringInLoop,
+                shared_from_this(),
+                buf
+            ));
+        }
+    }
+}
+
+void TcpConnection::send(std::string &&buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendStringInLoop(buf);
+        }
+        else
+        {
+            // 字符串移动到回调中，跨线程不产生拷贝
+            loop_->runInLoop(std::bind(
+                &TcpConnection::sendStringInLoop,
+                shared_from_this(),
+                std::move(buf)
+            ));
+        }
+    }
+}
+
+void TcpConnection::send(Buffer *buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        }
+        else
+        {
+            // 把buf的内容交换出来交给回调，调用者拿到的是一个空的buf
+            Buffer message;
+            message.swap(*buf);
             loop_->runInLoop(std::bind(
-                &TcpConnection::sendInLoop,
-                this,
-                buf.c_str(),
-                buf.size()
+                &TcpConnection::sendBufferInLoop,
+                shared_from_this(),
+                std::move(message)
             ));
         }
     }
 }
 
+void TcpConnection::send(const void *data, size_t len)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(data, len);
+        }
+        else
+        {
+            loop_->runInLoop(std::bind(
+                &TcpConnection::sendStringInLoop,
+                shared_from_this(),
+                std::string(static_cast<const char*>(data), len)
+            ));
+        }
+    }
+}
+
+void TcpConnection::send(const std::shared_ptr<const std::string> &buf)
+{
+    if (state_ == kConnected)
+    {
+        loop_->runInLoop(std::bind(
+            &TcpConnection::sendSharedInLoop,
+            shared_from_this(),
+            buf
+        ));
+    }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t length)
+{
+    if (state_ == kConnected)
+    {
+        int fileFd = ::dup(fd); // 队列持有自己的fd，调用者可以立即close
+        if (fileFd < 0)
+        {
+            LOG_ERROR("TcpConnection::sendFile dup fd=%d error:%d \n", fd, errno);
+            return;
+        }
+        loop_->runInLoop(std::bind(
+            &TcpConnection::sendFileInLoop,
+            shared_from_this(),
+            fileFd,
+            offset,
+            length
+        ));
+    }
+}
+
+void TcpConnection::sendPipe(int pipeFd, size_t length)
+{
+    if (state_ == kConnected)
+    {
+        int fd = ::dup(pipeFd);
+        if (fd < 0)
+        {
+            LOG_ERROR("TcpConnection::sendPipe dup fd=%d error:%d \n", pipeFd, errno);
+            return;
+        }
+        loop_->runInLoop(std::bind(
+            &TcpConnection::sendPipeInLoop,
+            shared_from_this(),
+            fd,
+            length
+        ));
+    }
+}
+
+void TcpConnection::sendStringInLoop(std::string &message)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+    size_t nwrote = 0;
+    if (writeDirectly(message.data(), message.size(), &nwrote) && nwrote < message.size())
+    {
+        size_t oldLen = outputQueue_.readableBytes();
+        outputQueue_.append(std::move(message), nwrote); // 剩下的部分连同string一起移交给发送队列
+        afterQueueOutput(oldLen);
+    }
+}
+
+void TcpConnection::sendSharedInLoop(const std::shared_ptr<const std::string> &message)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+    size_t nwrote = 0;
+    if (writeDirectly(message->data(), message->size(), &nwrote) && nwrote < message->size())
+    {
+        size_t oldLen = outputQueue_.readableBytes();
+        outputQueue_.append(message, nwrote);
+        afterQueueOutput(oldLen);
+    }
+}
+
+void TcpConnection::sendBufferInLoop(const Buffer &buf)
+{
+    sendInLoop(buf.peek(), buf.readableBytes());
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        ::close(fd);
+        return;
+    }
+    size_t oldLen = outputQueue_.readableBytes();
+    outputQueue_.appendFile(fd, offset, length);
+    sendQueuedInLoop(oldLen);
+}
+
+void TcpConnection::sendPipeInLoop(int fd, size_t length)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        ::close(fd);
+        return;
+    }
+    size_t oldLen = outputQueue_.readableBytes();
+    outputQueue_.appendPipe(fd, length);
+    sendQueuedInLoop(oldLen);
+}
+
+void TcpConnection::sendQueuedInLoop(size_t oldLen)
+{
+    // 和writeDirectly的条件一样，只有队列之前为空才能马上发送
+    if (oldLen == 0 && !autoCork_ && !waitingForWritable())
+    {
+        if (!writeQueuedOutput() || outputQueue_.readableBytes() == 0)
+        {
+            return;
+        }
+    }
+    afterQueueOutput(oldLen);
+}
+
 /**
  * 发送数据  应用写的快， 而内核发送数据慢， 需要把待发送数据写入缓冲区， 而且设置了水位回调
  */ 
 void TcpConnection::sendInLoop(const void* data, size_t len)
 {
-    ssize_t nwrote = 0;
-    size_t remaining = len;
-    bool faultError = false;
-
     // 之前调用过该connection的shutdown，不能再进行发送了
     if (state_ == kDisconnected)
     {
@@ -103,56 +338,168 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
         return;
     }
 
+    size_t nwrote = 0;
+    // 说明当前这一次write，并没有把数据全部发送出去，剩余的数据需要保存到缓冲区当中，然后给channel
+    // 注册epollout事件，poller发现tcp的发送缓冲区有空间，会通知相应的sock-channel，调用writeCallback_回调方法
+    // 也就是调用TcpConnection::handleWrite方法，把发送缓冲区中的数据全部发送完成
+    if (writeDirectly(data, len, &nwrote) && nwrote < len)
+    {
+        size_t oldLen = outputQueue_.readableBytes();
+        outputQueue_.append(static_cast<const char*>(data) + nwrote, len - nwrote);
+        afterQueueOutput(oldLen);
+    }
+}
+
+bool TcpConnection::writeDirectly(const void *data, size_t len, size_t *nwrote)
+{
+    *nwrote = 0;
     // 表示channel_第一次开始写数据，而且缓冲区没有待发送数据
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    // 否则直接写会打乱发送顺序，只能排在队列后面
+    // 开启autoCork_时总是先入队，等本轮循环末尾合并发送；完成模式总是入队，由sendmsg发送
+    if (autoCork_ || completionIo_ || waitingForWritable() || outputQueue_.readableBytes() > 0)
     {
-        nwrote = ::write(channel_->fd(), data, len);
-        if (nwrote >= 0)
+        return true;
+    }
+
+    ssize_t n = ::write(channel_->fd(), data, len);
+    if (n >= 0)
+    {
+        *nwrote = n;
+        if (static_cast<size_t>(n) == len && writeCompleteCallback_)
         {
-            remaining = len - nwrote;
-            if (remaining == 0 && writeCompleteCallback_)
-            {
-                // 既然在这里数据全部发送完成，就不用再给channel设置epollout事件了
-                loop_->queueInLoop(
-                    std::bind(writeCompleteCallback_, shared_from_this())
-                );
-            }
+            // 既然在这里数据全部发送完成，就不用再给channel设置epollout事件了
+            loop_->queueInLoop(
+                std::bind(writeCompleteCallback_, shared_from_this())
+            );
         }
-        else // nwrote < 0
+    }
+    else // n < 0
+    {
+        if (errno != EWOULDBLOCK)
         {
-            nwrote = 0;
-            if (errno != EWOULDBLOCK)
+            LOG_ERROR("TcpConnection::sendInLoop");
+            if (errno == EPIPE || errno == ECONNRESET) // SIGPIPE  RESET
             {
-                LOG_ERROR("TcpConnection::sendInLoop");
-                if (errno == EPIPE || errno == ECONNRESET) // SIGPIPE  RESET
-                {
-                    faultError = true;
-                }
+                return false;
             }
         }
     }
+    return true;
+}
 
-    // 说明当前这一次write，并没有把数据全部发送出去，剩余的数据需要保存到缓冲区当中，然后给channel
-    // 注册epollout事件，poller发现tcp的发送缓冲区有空间，会通知相应的sock-channel，调用writeCallback_回调方法
-    // 也就是调用TcpConnection::handleWrite方法，把发送缓冲区中的数据全部发送完成
-    if (!faultError && remaining > 0) 
+void TcpConnection::afterQueueOutput(size_t oldLen)
+{
+    // 目前发送缓冲区剩余的待发送数据的长度
+    size_t newLen = outputQueue_.readableBytes();
+    if (newLen >= highWaterMark_
+        && oldLen < highWaterMark_
+        && highWaterMarkCallback_)
+    {
+        loop_->queueInLoop(
+            std::bind(highWaterMarkCallback_, shared_from_this(), newLen)
+        );
+    }
+    if (waitingForWritable() || sendOp_ != 0)
     {
-        // 目前发送缓冲区剩余的待发送数据的长度
-        size_t oldLen = outputBuffer_.readableBytes();
-        if (oldLen + remaining >= highWaterMark_
-            && oldLen < highWaterMark_
-            && highWaterMarkCallback_)
+        return; // 已经在等待EPOLLOUT或者sendmsg完成，之后会把新数据一起发出去
+    }
+    if (autoCork_)
+    {
+        if (!corkFlushPending_)
         {
+            // 在loop线程中queueInLoop，回调会在本轮的doPendingFunctors中执行，
+            // 此时本轮所有channel的事件都已经处理完，这期间的send都已经入队了
+            corkFlushPending_ = true;
             loop_->queueInLoop(
-                std::bind(highWaterMarkCallback_, shared_from_this(), oldLen+remaining)
+                std::bind(&TcpConnection::flushCorkedOutput, shared_from_this())
             );
         }
-        outputBuffer_.append((char*)data + nwrote, remaining);
-        if (!channel_->isWriting())
+    }
+    else if (completionIo_)
+    {
+        startSend();
+    }
+    else if (edgeTriggered_)
+    {
+        // EPOLLOUT一直是注册着的，write没有写完说明socket发送缓冲区满了，有空间时一定会有一次通知
+        writeBlocked_ = true;
+    }
+    else
+    {
+        channel_->enableWriting(); // 这里一定要注册channel的写事件，否则poller不会给channel通知epollout
+    }
+}
+
+void TcpConnection::flushCorkedOutput()
+{
+    corkFlushPending_ = false;
+    if (state_ == kDisconnected || waitingForWritable() || sendOp_ != 0 || outputQueue_.readableBytes() == 0)
+    {
+        return;
+    }
+    if (completionIo_)
+    {
+        startSend();
+        return;
+    }
+
+    if (!writeQueuedOutput())
+    {
+        return; // 连接已经出错，等待读事件上报关闭
+    }
+    if (outputQueue_.readableBytes() == 0)
+    {
+        if (state_ == kDisconnecting)
         {
-            channel_->enableWriting(); // 这里一定要注册channel的写事件，否则poller不会给channel通知epollout
+            shutdownInLoop();
         }
     }
+    else if (!edgeTriggered_ && !waitingForWritable()) // 边沿触发时writeQueuedOutput已经写到了EAGAIN
+    {
+        channel_->enableWriting(); // 一次没有写完，剩下的交给handleWrite
+    }
+}
+
+bool TcpConnection::writeQueuedOutput()
+{
+    int savedErrno = 0;
+    ssize_t n;
+    // 边沿触发时必须写到EAGAIN：文件片段写完以后socket可能还有空间，不会再有EPOLLOUT通知
+    do
+    {
+        n = outputQueue_.writeFd(channel_->fd(), &savedErrno);
+        if (n > 0)
+        {
+            outputQueue_.retrieve(n);
+        }
+    } while (edgeTriggered_ && n >= 0 && outputQueue_.readableBytes() > 0);
+
+    if (edgeTriggered_)
+    {
+        writeBlocked_ = outputQueue_.readableBytes() > 0;
+    }
+    if (n < 0 && outputQueue_.emptyPipeFd() >= 0)
+    {
+        waitForPipe(outputQueue_.emptyPipeFd());
+        return true;
+    }
+    if (n < 0 && savedErrno != EWOULDBLOCK)
+    {
+        errno = savedErrno;
+        LOG_ERROR("TcpConnection::writeQueuedOutput");
+        if (savedErrno == EPIPE || savedErrno == ECONNRESET)
+        {
+            return false;
+        }
+    }
+
+    if (outputQueue_.readableBytes() == 0 && writeCompleteCallback_)
+    {
+        loop_->queueInLoop(
+            std::bind(writeCompleteCallback_, shared_from_this())
+        );
+    }
+    return true;
 }
 
 // 关闭连接
@@ -169,18 +516,67 @@ void TcpConnection::shutdown()
 
 void TcpConnection::shutdownInLoop()
 {
-    if (!channel_->isWriting()) // 说明outputBuffer中的数据已经全部发送完成
+    if (!waitingForWritable() && outputQueue_.readableBytes() == 0) // 说明发送队列中的数据已经全部发送完成
     {
         socket_->shutdownWrite(); // 关闭写端，并不关闭读端
     }
 }
 
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(
+            std::bind(&TcpConnection::forceCloseInLoop, shared_from_this())
+        );
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose(); // 和对端关闭连接的处理流程一样
+    }
+}
+
 // 连接建立
 void TcpConnection::connectEstablished()
 {
     setState(kConnected);
+    if (completionIo_ && !loop_->supportsAsyncIo())
+    {
+        completionIo_ = false; // loop不是io_uring，使用就绪模式
+    }
+    if (completionIo_ || !loop_->supportsEdgeTriggered())
+    {
+        edgeTriggered_ = false; // poll只有水平触发，一直关注EPOLLOUT会空转
+    }
+    if (useChainOutputBuffer_ || completionIo_)
+    {
+        // BlockPool属于loop，只能在loop线程中取，所以在这里而不是构造函数中设置
+        outputQueue_.setBlockPool(loop_->blockPool());
+    }
     channel_->tie(shared_from_this());
-    channel_->enableReading(); // 向poller注册channel的epollin事件
+    if (completionIo_)
+    {
+        startRecv(); // 完成模式不需要EPOLLIN，直接提交recv
+    }
+    else if (edgeTriggered_)
+    {
+        channel_->setEdgeTriggered(true);
+        channel_->enableReadingAndWriting(); // 连接的整个生命周期只有这一次epoll_ctl
+    }
+    else
+    {
+        channel_->enableReading(); // 向poller注册channel的epollin事件
+    }
+
+    if (idleWheel_)
+    {
+        idleEntry_ = idleWheel_->add(shared_from_this()); // 加入时间轮，开始空闲计时
+    }
 
     // 新连接建立，执行回调
     connectionCallback_(shared_from_this());
@@ -193,13 +589,199 @@ void TcpConnection::connectDestroyed()
     {
         setState(kDisconnected);
         channel_->disableAll(); // 把channel的所有感兴趣的事件，从poller中del掉
+        cancelCompletionIo();
         connectionCallback_(shared_from_this());
     }
     channel_->remove(); // 把channel从poller中删除掉
+    stopWaitingForPipe(); // 管道fd马上会随着发送队列一起关闭
+    loop_->addConnectionCount(-1);
+    if (sendOp_ == 0) // 还在sendmsg的数据要等取消完成以后在handleSendComplete中释放
+    {
+        outputQueue_.retrieveAll(); // 在loop线程中释放待发送数据，ChainBuffer的块要还给loop的BlockPool，TcpConnection可能在别的线程析构
+    }
+}
+
+void TcpConnection::startRecv()
+{
+    inputBuffer_.ensureWriteableBytes(kRecvBufferSize);
+    recvOp_ = loop_->asyncRecv(
+        channel_->fd(),
+        inputBuffer_.beginWrite(),
+        inputBuffer_.writableBytes(),
+        std::bind(&TcpConnection::handleRecvComplete, shared_from_this(),
+            std::placeholders::_1, std::placeholders::_2)
+    );
+}
+
+// 完成模式下对应handleRead，数据已经由内核写进了inputBuffer_
+void TcpConnection::handleRecvComplete(int res, Timestamp receiveTime)
+{
+    recvOp_ = 0;
+    if (state_ == kDisconnected)
+    {
+        return; // 连接已经关闭，包括被cancelCompletionIo取消的情况
+    }
+
+    if (res > 0)
+    {
+        inputBuffer_.hasWritten(res);
+        if (idleWheel_)
+        {
+            idleWheel_->touch(idleEntry_);
+        }
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        if (state_ != kDisconnected)
+        {
+            startRecv();
+        }
+    }
+    else if (res == 0)
+    {
+        handleClose();
+    }
+    else
+    {
+        errno = -res;
+        LOG_ERROR("TcpConnection::handleRecvComplete");
+        handleError();
+        handleClose(); // 完成模式下这个连接不会再有别的事件通知，出错以后直接关闭
+    }
+}
+
+void TcpConnection::startSend()
+{
+    int iovcnt = outputQueue_.peekIovecs(sendIov_, kMaxSendIovecs);
+    if (iovcnt == 0)
+    {
+        if (outputQueue_.readableBytes() > 0 && !waitingForPipe_)
+        {
+            channel_->enableWriting(); // 队头是文件或管道，交给handleWrite用sendfile/splice发送
+        }
+        return;
+    }
+
+    memset(&sendMsg_, 0, sizeof sendMsg_);
+    sendMsg_.msg_iov = sendIov_;
+    sendMsg_.msg_iovlen = iovcnt;
+    sendOp_ = loop_->asyncSendmsg(
+        channel_->fd(),
+        &sendMsg_,
+        std::bind(&TcpConnection::handleSendComplete, shared_from_this(),
+            std::placeholders::_1, std::placeholders::_2)
+    );
+}
+
+// 完成模式下对应handleWrite
+void TcpConnection::handleSendComplete(int res, Timestamp)
+{
+    sendOp_ = 0;
+    if (state_ == kDisconnected)
+    {
+        outputQueue_.retrieveAll(); // 内核已经不再使用这些数据，可以释放了
+        return;
+    }
+    if (res < 0)
+    {
+        errno = -res;
+        LOG_ERROR("TcpConnection::handleSendComplete");
+        return; // 连接出错，recv会收到错误或者EOF，在那里关闭连接
+    }
+
+    outputQueue_.retrieve(res);
+    if (outputQueue_.readableBytes() == 0)
+    {
+        if (writeCompleteCallback_)
+        {
+            loop_->queueInLoop(
+                std::bind(writeCompleteCallback_, shared_from_this())
+            );
+        }
+        if (state_ == kDisconnecting)
+        {
+            shutdownInLoop();
+        }
+    }
+    else
+    {
+        startSend(); // 发送期间又有新数据入队，或者一次没有发完
+    }
+}
+
+void TcpConnection::cancelCompletionIo()
+{
+    if (recvOp_ != 0)
+    {
+        loop_->cancelAsyncIo(recvOp_);
+    }
+    if (sendOp_ != 0)
+    {
+        loop_->cancelAsyncIo(sendOp_);
+    }
+}
+
+bool TcpConnection::waitingForWritable() const
+{
+    return waitingForPipe_ || (edgeTriggered_ ? writeBlocked_ : channel_->isWriting());
+}
+
+void TcpConnection::waitForPipe(int pipeFd)
+{
+    waitingForPipe_ = true;
+    writeBlocked_ = false;
+    if (!edgeTriggered_ && channel_->isWriting())
+    {
+        channel_->disableWriting(); // socket一直可写，水平触发时继续关注EPOLLOUT会空转
+    }
+    if (!pipeChannel_ || pipeChannel_->fd() != pipeFd)
+    {
+        // 不会在pipeChannel_自己的回调中走到这里，可以直接替换
+        pipeChannel_.reset(new Channel(loop_, pipeFd));
+        pipeChannel_->setReadCallback(std::bind(&TcpConnection::handlePipeReadable, this));
+        pipeChannel_->setCloseCallback(std::bind(&TcpConnection::handlePipeReadable, this)); // 写端关闭，splice会返回0
+        pipeChannel_->tie(shared_from_this());
+    }
+    if (!pipeChannel_->isReading())
+    {
+        pipeChannel_->enableReading();
+    }
+}
+
+void TcpConnection::handlePipeReadable()
+{
+    stopWaitingForPipe();
+    if (state_ == kDisconnected || outputQueue_.readableBytes() == 0)
+    {
+        return;
+    }
+    if (edgeTriggered_)
+    {
+        // EPOLLOUT一直注册着但不会再有新的边沿，主动写一次；放到pipeChannel_的回调之外，写的时候可能要换一个管道
+        loop_->queueInLoop(std::bind(&TcpConnection::handleWrite, shared_from_this()));
+    }
+    else
+    {
+        channel_->enableWriting(); // socket可写，下一轮就会调用handleWrite
+    }
+}
+
+void TcpConnection::stopWaitingForPipe()
+{
+    if (waitingForPipe_)
+    {
+        waitingForPipe_ = false;
+        pipeChannel_->disableAll();
+        pipeChannel_->remove();
+    }
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
+    if (edgeTriggered_)
+    {
+        handleReadEdgeTriggered(receiveTime);
+        return;
+    }
+
     /*
         handleRead负责处理Tcp连接的可读事件，它会将客户端发送来的数据拷贝到用户缓冲区中（inputBuffer_）
         然后再调用connectionCallback_保存的 [连接建立后的处理函数]
@@ -215,6 +797,10 @@ void TcpConnection::handleRead(Timestamp receiveTime)
     */
     if (n > 0) // 从fd上读取到了数据，并且放在了inputbuffer上
     {
+        if (idleWheel_)
+        {
+            idleWheel_->touch(idleEntry_); // 刷新空闲计时，只是往最新的桶里放一个引用
+        }
         // 已建立连接的用户，有可读事件发生了，调用用户传入的回调操作onMessage
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
     }
@@ -236,19 +822,85 @@ void TcpConnection::handleRead(Timestamp receiveTime)
     }
 }
 
+// 边沿触发的可读事件：一直读到EAGAIN，读到的数据合并成一次messageCallback_
+// 超过kEdgeReadBudget还没有读完时不会再有通知，投递到本轮循环末尾接着读，让同一个loop上的其他连接先处理
+void TcpConnection::handleReadEdgeTriggered(Timestamp receiveTime)
+{
+    if (state_ == kDisconnected)
+    {
+        return; // 接着读的回调执行之前连接已经关闭
+    }
+
+    size_t total = 0;
+    int savedErrno = 0;
+    ssize_t n;
+    while ((n = inputBuffer_.readFd(channel_->fd(), &savedErrno)) > 0)
+    {
+        total += n;
+        if (total >= kEdgeReadBudget)
+        {
+            break;
+        }
+    }
+
+    if (total > 0)
+    {
+        if (idleWheel_)
+        {
+            idleWheel_->touch(idleEntry_);
+        }
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        if (state_ == kDisconnected)
+        {
+            return; // 回调中调用了forceClose之类的
+        }
+    }
+
+    if (n > 0)
+    {
+        loop_->queueInLoop(
+            std::bind(&TcpConnection::handleReadEdgeTriggered, shared_from_this(), receiveTime)
+        );
+    }
+    else if (n == 0)
+    {
+        handleClose();
+    }
+    else if (savedErrno != EWOULDBLOCK)
+    {
+        errno = savedErrno;
+        LOG_ERROR("TcpConnection::handleRead");
+        handleError();
+    }
+}
+
 void TcpConnection::handleWrite() 
 {
     /*
         负责处理Tcp连接的可写事件
     */
+    if (edgeTriggered_)
+    {
+        // 边沿触发时EPOLLOUT一直注册着，队列为空或者在等管道时的通知直接忽略
+        if (state_ == kDisconnected || waitingForPipe_ || outputQueue_.readableBytes() == 0)
+        {
+            return;
+        }
+        if (writeQueuedOutput() && outputQueue_.readableBytes() == 0 && state_ == kDisconnecting)
+        {
+            shutdownInLoop();
+        }
+        return;
+    }
     if (channel_->isWriting())
     {
         int savedErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
-        if (n > 0)
+        ssize_t n = outputQueue_.writeFd(channel_->fd(), &savedErrno);
+        // 文件片段提前读到末尾时writeFd丢弃剩下的长度并返回0，队列也可能因此变空
+        if (n >= 0)
         {
-            outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0)
+            outputQueue_.retrieve(n);
+            if (outputQueue_.readableBytes() == 0)
             {
                 channel_->disableWriting();
                 if (writeCompleteCallback_)
@@ -263,9 +915,20 @@ void TcpConnection::handleWrite()
                     shutdownInLoop();
                 }
             }
+            else if (completionIo_)
+            {
+                // 完成模式只在队头是文件或管道时才用EPOLLOUT，其余的数据交回给sendmsg
+                channel_->disableWriting();
+                startSend();
+            }
         }
-        else
+        else if (outputQueue_.emptyPipeFd() >= 0)
+        {
+            waitForPipe(outputQueue_.emptyPipeFd());
+        }
+        else if (savedErrno != EWOULDBLOCK)
         {
+            errno = savedErrno;
             LOG_ERROR("TcpConnection::handleWrite");
         }
     }
@@ -281,10 +944,15 @@ void TcpConnection::handleClose()
     LOG_INFO("TcpConnection::handleClose fd=%d state=%d \n", channel_->fd(), (int)state_);
     setState(kDisconnected);
     channel_->disableAll();
+    cancelCompletionIo();
+    stopWaitingForPipe();
 
     TcpConnectionPtr connPtr(shared_from_this());
     connectionCallback_(connPtr); // 执行连接关闭的回调
-    closeCallback_(connPtr); // 关闭连接的回调  执行的是TcpServer::removeConnection回调方法
+    if (closeCallback_) // TcpServer析构时会清掉
+    {
+        closeCallback_(connPtr); // 关闭连接的回调  执行的是TcpServer::removeConnection回调方法
+    }
 }
 
 void TcpConnection::handleError()
@@ -300,5 +968,5 @@ void TcpConnection::handleError()
     {
         err = optval;
     }
-    LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d \n", name_.c_str(), err);
+    LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d \n", name().c_str(), err);
 }
\ No newline at end of file
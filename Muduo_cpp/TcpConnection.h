@@ -5,10 +5,16 @@
 #include "Callbacks.h"
 #include "Buffer.h"
 #include "Timestamp.h"
+#include "TimingWheel.h"
+#include "OutputQueue.h"
 
 #include <memory>
 #include <string>
 #include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 class Channel;
 class EventLoop;
@@ -26,20 +32,42 @@ public:
                 const std::string &name, 
                 int sockfd, // acceptr已连接的文件描述符
                 const InetAddress& localAddr, // 本机地址 
-                const InetAddress& peerAddr); // 对端地址
+                const InetAddress& peerAddr, // 对端地址
+                uint64_t id = 0); // TcpServer分配的连接id，在同一个TcpServer中唯一
+    // 名字是namePrefix#id，第一次调用name()时才拼接，accept新连接时不用为每个连接格式化名字
+    TcpConnection(EventLoop *loop,
+                const std::shared_ptr<const std::string> &namePrefix,
+                int sockfd,
+                const InetAddress& localAddr,
+                const InetAddress& peerAddr,
+                uint64_t id);
     ~TcpConnection();
 
     EventLoop* getLoop() const { return loop_; }
-    const std::string& name() const { return name_; }
+    const std::string& name() const;
+    uint64_t id() const { return id_; }
     const InetAddress& localAddress() const { return localAddr_; }
     const InetAddress& peerAddress() const { return peerAddr_; }
 
     bool connected() const { return state_ == kConnected; } // 判断是否已经简历连接
 
-    // 发送数据
-    void send(const std::string &buf);
+    // 发送数据，线程安全
+    // 在其他线程调用时，数据的所有权会转移到投递给loop的回调中，调用返回后调用者的数据可以立即释放
+    void send(const std::string &buf); // 其他线程调用时拷贝一次
+    void send(std::string &&buf);      // 其他线程调用时移动，不拷贝
+    void send(Buffer *buf);            // 取走buf中的全部可读数据，其他线程调用时交换内容，不拷贝
+    void send(const void *data, size_t len); // 其他线程调用时拷贝一次
+    void send(const std::shared_ptr<const std::string> &buf); // 多个连接共享同一份数据，任何情况下都不拷贝
+    // 发送文件fd中从offset开始的length字节，可写时用sendfile直接从page cache发送，线程安全
+    // 内部会dup一份fd，调用返回后调用者可以close自己的fd；排在之前send的数据后面，同样计入高水位和writeComplete
+    void sendFile(int fd, off_t offset, size_t length);
+    // 把管道读端pipeFd中的length字节用splice直接搬到socket，用于代理，线程安全，同样会dup一份fd
+    // 数据要由调用者写入管道，管道暂时为空时不再等socket可写，改为等管道可读以后继续发送
+    void sendPipe(int pipeFd, size_t length);
     // 关闭连接
     void shutdown();
+    // 强制关闭连接，不等待outputBuffer中的数据发送完成，线程安全
+    void forceClose();
 
     void setConnectionCallback(const ConnectionCallback& cb)
     { connectionCallback_ = cb; }
@@ -56,6 +84,24 @@ public:
     void setCloseCallback(const CloseCallback& cb)
     { closeCallback_ = cb; }
 
+    // 发送队列中kCopy的数据改用ChainBuffer存放，块从所属loop的BlockPool中分配，必须在connectEstablished之前设置
+    void setChainOutputBuffer(bool on) { useChainOutputBuffer_ = on; }
+
+    // 自动合并写：同一轮循环中的多次send只放入发送队列，在本轮循环处理完回调后用一次writev发出去
+    void setAutoCork(bool on) { autoCork_ = on; }
+
+    // 完成模式：由内核直接把数据recv进inputBuffer_、从发送队列sendmsg出去，完成事件驱动messageCallback_和writeCompleteCallback_
+    // 只有loop使用io_uring时生效，否则仍然是就绪模式；必须在connectEstablished之前设置
+    void setCompletionIo(bool on) { completionIo_ = on; }
+
+    // 边沿触发：连接建立时一次注册EPOLLIN|EPOLLOUT|EPOLLET，读写都做到EAGAIN为止，
+    // 写不完时不再需要epoll_ctl打开/关闭EPOLLOUT；开启了完成模式或者poller不支持边沿触发时不生效；必须在connectEstablished之前设置
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+    // 开启空闲超时，必须在connectEstablished之前设置
+    void setIdleTimingWheel(const std::shared_ptr<TimingWheel>& wheel)
+    { idleWheel_ = wheel; }
+
     // 连接建立
     void connectEstablished();
 
@@ -66,21 +112,62 @@ private:
     enum StateE {kDisconnected, kConnecting, kConnected, kDisconnecting};
     void setState(StateE state) { state_ = state; }
 
+    TcpConnection(EventLoop *loop,
+                const std::string &name,
+                const std::shared_ptr<const std::string> &namePrefix,
+                int sockfd,
+                const InetAddress& localAddr,
+                const InetAddress& peerAddr,
+                uint64_t id);
+
     // 事件读写关闭错误，注册在channel上
     /*
         在一个已经建立好的Tcp连接上主要会发生四类事件：可读事件、可写事件、连接关闭事件、错误事件。
         当事件监听器监听到一个连接发生了以上的事件，那么就会在EventLoop中调用这些事件对应的处理函数。
     */
     void handleRead(Timestamp receiveTime);
+    void handleReadEdgeTriggered(Timestamp receiveTime);
     void handleWrite();
     void handleClose();
     void handleError();
 
     void sendInLoop(const void* message, size_t len);
+    void sendStringInLoop(std::string &message); // message的所有权转移到发送队列中
+    void sendSharedInLoop(const std::shared_ptr<const std::string> &message);
+    void sendBufferInLoop(const Buffer &buf);
+    void sendFileInLoop(int fd, off_t offset, size_t length); // 接管fd
+    void sendPipeInLoop(int fd, size_t length);               // 接管fd
+    // 文件或管道片段入队以后调用，队列原来为空时马上发送一次
+    void sendQueuedInLoop(size_t oldLen);
+    // 把发送队列写一次（边沿触发时一直写到EAGAIN），全部写完时投递writeComplete，返回false表示连接出错
+    bool writeQueuedOutput();
+    // 发送队列中还有数据在等待可写事件(水平触发时就是channel关注了EPOLLOUT)，或者在等队头的管道可读
+    bool waitingForWritable() const;
+    // 队头的管道暂时为空，停止等待EPOLLOUT，用pipeChannel_等管道可读
+    void waitForPipe(int pipeFd);
+    void handlePipeReadable();
+    void stopWaitingForPipe();
+    // 发送队列为空时先直接write，nwrote返回写出去的字节数，返回false表示连接出错，剩下的数据不需要再入队
+    bool writeDirectly(const void *data, size_t len, size_t *nwrote);
+    // 数据放入发送队列以后调用，检查高水位并注册EPOLLOUT，oldLen是放入之前队列中的字节数
+    void afterQueueOutput(size_t oldLen);
+    // 开启autoCork_时，本轮循环末尾把发送队列一次性写出去
+    void flushCorkedOutput();
     void shutdownInLoop();
+    void forceCloseInLoop();
+
+    // 完成模式，completionIo_为true时使用
+    void startRecv();
+    void handleRecvComplete(int res, Timestamp receiveTime);
+    void startSend();
+    void handleSendComplete(int res, Timestamp completionTime);
+    void cancelCompletionIo(); // 连接关闭时取消还在进行的recv/sendmsg
 
     EventLoop *loop_; // 这里绝对不是baseLoop， 因为TcpConnection都是在subLoop里面管理的
-    const std::string name_; // 
+    const std::shared_ptr<const std::string> namePrefix_; // 为空时name_在构造时给定
+    mutable std::string name_; // 
+    mutable std::once_flag nameOnce_;
+    const uint64_t id_;
     std::atomic_int state_; // 这个成员变量标识了当前TCP连接的状态（Connected、Connecting、Disconnecting、Disconnected）
     bool reading_; // 
 
@@ -100,12 +187,39 @@ private:
     CloseCallback closeCallback_;
     size_t highWaterMark_;
 
+    // 空闲超时，idleWheel_为空表示没有开启
+    std::shared_ptr<TimingWheel> idleWheel_;
+    TimingWheel::WeakEntryPtr idleEntry_; // 连接在时间轮中的条目，收到数据时touch
+
     // 数据缓冲区
     Buffer inputBuffer_;  // inputBuffer_ 是一个Buffer类，是该TCP连接对应的用户接收缓冲区。
-    Buffer outputBuffer_;
+    OutputQueue outputQueue_;
     /*
-        outputBuffer_也是一个Buffer类，不过是用于暂存那些暂时发送不出去的待发送数据。因为Tcp发送缓冲区是有大小限制的，
-        假如达到了高水位线，就没办法把发送的数据通过send()直接拷贝到Tcp发送缓冲区，而是暂存在这个outputBuffer_中，
-        等TCP发送缓冲区有空间了，触发可写事件了，再把outputBuffer_中的数据拷贝到Tcp发送缓冲区中。
+        outputQueue_用于暂存那些暂时发送不出去的待发送数据。因为Tcp发送缓冲区是有大小限制的，
+        假如达到了高水位线，就没办法把发送的数据通过send()直接拷贝到Tcp发送缓冲区，而是暂存在这个outputQueue_中，
+        等TCP发送缓冲区有空间了，触发可写事件了，再用一次writev把outputQueue_中的数据写到Tcp发送缓冲区中。
+        调用者移交的string和共享的数据只在队列里记录一个片段，不会拷贝。
     */
+    bool useChainOutputBuffer_; // 在connectEstablished中给outputQueue_设置BlockPool
+    bool autoCork_;
+    bool corkFlushPending_; // 本轮循环已经投递过flushCorkedOutput
+
+    static const size_t kEdgeReadBudget = 256 * 1024; // 边沿触发时一次可读事件最多读这么多，剩下的放到本轮循环末尾继续读
+
+    bool edgeTriggered_;
+    bool writeBlocked_; // 边沿触发时写到了EAGAIN，等待EPOLLOUT
+
+    std::unique_ptr<Channel> pipeChannel_; // 队头管道的fd，只在waitingForPipe_时注册在poller上
+    bool waitingForPipe_;
+
+    static const size_t kRecvBufferSize = 16 * 1024; // 完成模式每次recv至少给inputBuffer_留出的空间
+    static const int kMaxSendIovecs = 64;
+
+    // 完成模式下的状态，recvOp_/sendOp_是正在进行的操作的id，0表示没有
+    // 发送中的数据必须保持地址不变，所以完成模式总是用ChainBuffer存放拷贝的数据
+    bool completionIo_;
+    uint64_t recvOp_;
+    uint64_t sendOp_;
+    struct msghdr sendMsg_;
+    struct iovec sendIov_[kMaxSendIovecs];
 };
\ No newline at end of file
@@ -4,6 +4,9 @@
 
 #include <strings.h>
 #include <functional>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
 
 static EventLoop* CheckLoopNotNull(EventLoop *loop)
 {
@@ -21,31 +24,78 @@ TcpServer::TcpServer(EventLoop *loop,
                 : loop_(CheckLoopNotNull(loop))
                 , ipPort_(listenAddr.toIpPort())
                 , name_(nameArg)
-                , acceptor_(new Acceptor(loop, listenAddr, option == kReusePort))
+                , connNamePrefix_(std::make_shared<const std::string>(name_ + "-" + ipPort_))
+                , listenAddr_(listenAddr)
+                , option_(option)
+                , acceptor_(option != kReusePortPerLoop ? new Acceptor(loop, listenAddr, option != kNoReusePort) : nullptr)
                 , threadPool_(new EventLoopThreadPool(loop, name_))
                 , connectionCallback_()
                 , messageCallback_()
                 , nextConnId_(1)
                 , started_(0)
+                , chainOutputBuffer_(false)
+                , autoCork_(false)
+                , completionIo_(false)
+                , edgeTriggered_(false)
+                , acceptBatch_(1)
+                , acceptBackoff_(0)
+                , maxAcceptBackoff_(0)
+                , idleSeconds_(0)
 {
-    // 当有先用户连接时，会执行TcpServer::newConnection回调
-    acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, 
-        std::placeholders::_1, std::placeholders::_2));
+    if (acceptor_)
+    {
+        // 当有先用户连接时，会执行TcpServer::newConnections回调
+        acceptor_->setNewConnectionBatchCallback(std::bind(&TcpServer::newConnections, this, 
+            std::placeholders::_1));
+    }
 }
 
 TcpServer::~TcpServer()
 {
+    // 下面投递给各个loop的回调都执行完才能返回
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t pending = loopAcceptors_.size() + connections_.size();
+    auto finish = [&mutex, &cond, &pending]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0)
+        {
+            cond.notify_one();
+        }
+    };
+
+    // subloop的Acceptor在它自己的loop中析构，把channel从那个loop的poller中删除，之后不会再回调newConnectionOnLoop
+    // 排在同一个loop销毁分片的回调前面，分片销毁以后不会再有新连接登记进来
+    for (std::shared_ptr<Acceptor> &acceptor : loopAcceptors_)
+    {
+        std::shared_ptr<Acceptor> a(std::move(acceptor));
+        a->ownerLoop()->runInLoop([a, &finish]() mutable {
+            a.reset();
+            finish();
+        });
+    }
+
+    // 分片只能在所属的loop中访问，交给那个loop去销毁其中的连接：
+    // 之前已经投递给subloop的establishConnections、removeConnectionInLoop还会用到this
     for (auto &item : connections_)
     {
-        // 这个局部的shared_ptr智能指针对象，出右括号，可以自动释放new出来的TcpConnection对象资源了
-        TcpConnectionPtr conn(item.second); 
-        item.second.reset();
-
-        // 销毁连接
-        conn->getLoop()->runInLoop(
-            std::bind(&TcpConnection::connectDestroyed, conn)
-        );
+        std::shared_ptr<ConnectionMap> shard(item.second); // 只复制指针，start之后不再改动connections_
+        item.first->runInLoop([shard, &finish]() {
+            for (auto &entry : *shard)
+            {
+                // 这个局部的shared_ptr智能指针对象，出右括号，可以自动释放new出来的TcpConnection对象资源了
+                TcpConnectionPtr conn(entry.second);
+                entry.second.reset();
+                conn->setCloseCallback(nullptr); // 回调绑定了this，之后连接不能再回调到TcpServer
+                conn->connectDestroyed(); // 销毁连接
+            }
+            shard->clear();
+            finish();
+        });
     }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&pending]() { return pending == 0; });
 }
 
 // 设置底层subloop的个数
@@ -54,28 +104,153 @@ void TcpServer::setThreadNum(int numThreads)
     threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setThreadBusyPoll(int index, int spinMicros)
+{
+    threadPool_->setThreadBusyPoll(index, spinMicros);
+}
+
+void TcpServer::setLoadBalancer(LoadBalancer::Strategy strategy)
+{
+    setLoadBalancer(LoadBalancer::newLoadBalancer(strategy));
+}
+
+void TcpServer::setLoadBalancer(LoadBalancer *balancer)
+{
+    threadPool_->setLoadBalancer(std::unique_ptr<LoadBalancer>(balancer));
+}
+
 // 开启服务器监听   loop.loop()
 void TcpServer::start()
 {
     if (started_++ == 0) // 也就是这是mainreactor开启服务端监听
     {
         threadPool_->start(threadInitCallback_); // 启动底层的loop线程池
-        loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        for (EventLoop *ioLoop : threadPool_->getAllLoops())
+        {
+            connections_[ioLoop] = std::make_shared<ConnectionMap>();
+        }
+        if (idleSeconds_ > 0)
+        {
+            // 每个loop一个时间轮，连接只会被加入到它所属loop的时间轮中
+            for (EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                std::shared_ptr<TimingWheel> wheel(new TimingWheel(ioLoop, idleSeconds_));
+                wheel->start();
+                idleWheels_[ioLoop] = wheel;
+            }
+        }
+        std::vector<EventLoop*> subLoops = threadPool_->getAllLoops();
+        if (option_ == kReusePortPerLoop && subLoops.front() != loop_)
+        {
+            for (EventLoop *ioLoop : subLoops)
+            {
+                std::shared_ptr<Acceptor> acceptor(new Acceptor(ioLoop, listenAddr_, true));
+                acceptor->setAcceptBatch(acceptBatch_);
+                acceptor->setAcceptBackoff(acceptBackoff_, maxAcceptBackoff_);
+                acceptor->setNewConnectionCallback(std::bind(&TcpServer::newConnectionOnLoop, this,
+                    ioLoop, std::placeholders::_1, std::placeholders::_2));
+                loopAcceptors_.push_back(acceptor);
+                ioLoop->runInLoop(std::bind(&Acceptor::listen, acceptor.get()));
+            }
+        }
+        else
+        {
+            if (!acceptor_)
+            {
+                // kReusePortPerLoop但是没有subloop，和kReusePort一样由baseLoop accept
+                acceptor_.reset(new Acceptor(loop_, listenAddr_, true));
+                acceptor_->setNewConnectionBatchCallback(std::bind(&TcpServer::newConnections, this,
+                    std::placeholders::_1));
+            }
+            acceptor_->setAcceptBatch(acceptBatch_);
+            acceptor_->setAcceptBackoff(acceptBackoff_, maxAcceptBackoff_);
+            loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        }
+    }
+}
+
+int64_t TcpServer::acceptWakeups() const
+{
+    int64_t n = acceptor_ ? acceptor_->acceptWakeups() : 0;
+    for (const std::shared_ptr<Acceptor> &acceptor : loopAcceptors_)
+    {
+        n += acceptor ? acceptor->acceptWakeups() : 0;
+    }
+    return n;
+}
+
+int64_t TcpServer::acceptedConnections() const
+{
+    int64_t n = acceptor_ ? acceptor_->acceptedConnections() : 0;
+    for (const std::shared_ptr<Acceptor> &acceptor : loopAcceptors_)
+    {
+        n += acceptor ? acceptor->acceptedConnections() : 0;
     }
+    return n;
 }
 
-// 有一个新的客户端的连接，acceptor会执行这个回调操作
-void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
+int64_t TcpServer::rejectedConnections() const
 {
-    // 轮询算法，选择一个subLoop，来管理channel
-    EventLoop *ioLoop = threadPool_->getNextLoop(); 
-    char buf[64] = {0};
-    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
-    std::string connName = name_ + buf;
+    int64_t n = acceptor_ ? acceptor_->rejectedConnections() : 0;
+    for (const std::shared_ptr<Acceptor> &acceptor : loopAcceptors_)
+    {
+        n += acceptor ? acceptor->rejectedConnections() : 0;
+    }
+    return n;
+}
+
+// 有新的客户端的连接，acceptor会执行这个回调操作
+void TcpServer::newConnections(const Acceptor::AcceptedList &accepted)
+{
+    // 按目标subloop分组，每个subloop只投递一个回调，一批连接只需要唤醒每个subloop一次
+    std::vector<std::pair<EventLoop*, std::vector<TcpConnectionPtr>>> batches;
+    for (const Acceptor::AcceptedConnection &a : accepted)
+    {
+        // 按负载均衡策略(默认轮询)选择一个subLoop，来管理channel
+        EventLoop *ioLoop = threadPool_->getNextLoop(a.peerAddr);
+        TcpConnectionPtr conn = createConnection(ioLoop, a.sockfd, a.peerAddr);
+        auto it = std::find_if(batches.begin(), batches.end(),
+            [ioLoop](const std::pair<EventLoop*, std::vector<TcpConnectionPtr>> &b) { return b.first == ioLoop; });
+        if (it == batches.end())
+        {
+            batches.emplace_back(ioLoop, std::vector<TcpConnectionPtr>());
+            it = batches.end() - 1;
+        }
+        it->second.push_back(conn);
+    }
+    for (auto &batch : batches)
+    {
+        batch.first->runInLoop(std::bind(&TcpServer::establishConnections, this, std::move(batch.second)));
+    }
+}
+
+void TcpServer::establishConnections(const std::vector<TcpConnectionPtr> &conns)
+{
+    for (const TcpConnectionPtr &conn : conns)
+    {
+        establishConnection(conn);
+    }
+}
 
-    LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s \n",
-        name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
+void TcpServer::establishConnection(const TcpConnectionPtr &conn)
+{
+    connections_.at(conn->getLoop())->emplace(conn->id(), conn);
+    conn->connectEstablished();
+}
+
+void TcpServer::newConnectionOnLoop(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr)
+{
+    TcpConnectionPtr conn = createConnection(ioLoop, sockfd, peerAddr);
+    // kReusePortPerLoop时已经在ioLoop线程中，直接执行，不需要跨线程
+    ioLoop->runInLoop(std::bind(&TcpServer::establishConnection, this, conn));
+}
+
+TcpConnectionPtr TcpServer::createConnection(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr)
+{
+    const uint64_t connId = nextConnId_.fetch_add(1, std::memory_order_relaxed);
+
+    LOG_INFO("TcpServer::newConnection [%s] - new connection [%s#%llu] from %s \n",
+        name_.c_str(), connNamePrefix_->c_str(), static_cast<unsigned long long>(connId), peerAddr.toIpPort().c_str());
 
     // 通过sockfd获取其绑定的本机的ip地址和端口信息
     sockaddr_in local;
@@ -88,24 +263,33 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
     InetAddress localAddr(local);
 
     // 根据连接成功的sockfd，创建TcpConnection连接对象
-    TcpConnectionPtr conn(new TcpConnection(ioLoop,connName,sockfd, localAddr,peerAddr) );
-
-    connections_[connName] = conn;
+    // 连接在connectEstablished之前由所属loop登记到connections_中
+    // 连接的名字在第一次用到时才拼接，不占用accept新连接的时间
+    TcpConnectionPtr conn(new TcpConnection(ioLoop,connNamePrefix_,sockfd, localAddr,peerAddr, connId) );
     // 下面的回调都是用户设置给TcpServer=>TcpConnection=>Channel=>Poller=>notify channel调用回调
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setChainOutputBuffer(chainOutputBuffer_);
+    conn->setAutoCork(autoCork_);
+    conn->setCompletionIo(completionIo_);
+    conn->setEdgeTriggered(edgeTriggered_);
+    if (idleSeconds_ > 0)
+    {
+        conn->setIdleTimingWheel(idleWheels_.at(ioLoop)); // 多个subloop同时读，不能用operator[]
+    }
 
     // 设置了如何关闭连接的回调   conn->shutDown()
     conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, std::placeholders::_1) );
 
-    // 直接调用TcpConnection::connectEstablished
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+    return conn;
 }
 
 void TcpServer::removeConnection(const TcpConnectionPtr &conn)
 {
-    loop_->runInLoop(
+    // 连接登记在所属loop的分片中，也在所属loop中删除，不用再绕回baseLoop
+    // closeCallback总是在连接所属的loop中调用，这里会直接执行
+    conn->getLoop()->runInLoop(
         std::bind(&TcpServer::removeConnectionInLoop, this, conn)
     );
 }
@@ -115,8 +299,8 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
     LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s\n", 
         name_.c_str(), conn->name().c_str());
 
-    connections_.erase(conn->name());
     EventLoop *ioLoop = conn->getLoop(); 
+    connections_.at(ioLoop)->erase(conn->id());
     ioLoop->queueInLoop(
         std::bind(&TcpConnection::connectDestroyed, conn)
     );
@@ -8,6 +8,7 @@
 #include "InetAddress.h"
 #include "noncopyable.h"
 #include "EventLoopThreadPool.h"
+#include "LoadBalancer.h"
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
@@ -16,6 +17,7 @@
 #include <string>
 #include <memory>
 #include <atomic>
+#include <vector>
 #include <unordered_map>
 
 // 对外的服务器编程使用的类
@@ -28,6 +30,9 @@ public:
     {
         kNoReusePort,
         kReusePort,
+        // 每个subloop各有一个绑定同一端口的Acceptor，由内核把新连接分散到各个监听socket上，
+        // 连接在哪个loop上accept就属于哪个loop，不再经过baseLoop转手；没有subloop时和kReusePort相同
+        kReusePortPerLoop,
     };
 
     TcpServer(EventLoop *loop, //loop指针
@@ -43,24 +48,78 @@ public:
 
     // 设置底层subloop的个数
     void setThreadNum(int numThreads);
+    // 只让第index个subloop忙轮询spinMicros微秒，用一个CPU核换取更低的尾延迟，见EventLoop::setBusyPoll
+    void setThreadBusyPoll(int index, int spinMicros);
+
+    // 新连接分配给subloop的策略，默认轮询，必须在start之前调用；kReusePortPerLoop时由内核分配，不使用
+    void setLoadBalancer(LoadBalancer::Strategy strategy);
+    // 自定义的策略，接管balancer
+    void setLoadBalancer(LoadBalancer *balancer);
+
+    // 连接的发送缓冲区改用由16K固定大小块组成的ChainBuffer，块来自每个loop的BlockPool，必须在start之前调用
+    void setChainOutputBuffer(bool on) { chainOutputBuffer_ = on; }
+
+    // 开启自动合并写，请求/响应类协议在一次onMessage中多次send只产生一次writev，必须在start之前调用
+    void setAutoCork(bool on) { autoCork_ = on; }
+
+    // 开启完成模式，subloop是io_uring时连接用异步recv/sendmsg收发数据，否则仍然是就绪模式，必须在start之前调用
+    void setCompletionIo(bool on) { completionIo_ = on; }
+
+    // 连接使用边沿触发，读写都做到EAGAIN为止，写不完时不需要反复epoll_ctl，必须在start之前调用
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+    // 开启空闲连接超时，seconds秒内没有收到数据的连接会被关闭，必须在start之前调用
+    void setIdleTimeout(int seconds) { idleSeconds_ = seconds; }
+
+    // 每次可读事件最多accept多少个新连接，默认1，必须在start之前调用
+    // baseLoop一次accept到的连接按目标subloop分组，每个subloop只投递一个回调
+    void setAcceptBatch(int maxAccepts) { acceptBatch_ = maxAccepts; }
+
+    // 所有Acceptor可读事件的次数和accept到的连接数，可以在任意线程读取
+    int64_t acceptWakeups() const;
+    int64_t acceptedConnections() const;
+
+    // fd用完时暂停accept的时长，连续用完时加倍直到maxSeconds，默认不暂停，必须在start之前调用
+    void setAcceptBackoff(double initialSeconds, double maxSeconds)
+    {
+        acceptBackoff_ = initialSeconds;
+        maxAcceptBackoff_ = maxSeconds;
+    }
+    // fd用完时被直接关闭的连接数，可以在任意线程读取
+    int64_t rejectedConnections() const;
 
     // 开启服务器监听
     void start();
 private:
-    void newConnection(int sockfd, const InetAddress &peerAddr);
+    // baseLoop的Acceptor一次accept到的连接
+    void newConnections(const Acceptor::AcceptedList &accepted);
+    // 在ioLoop上为sockfd创建TcpConnection，kReusePortPerLoop时直接在ioLoop线程中调用
+    void newConnectionOnLoop(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr);
+    TcpConnectionPtr createConnection(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr);
+    // 在连接所属的loop中登记连接并调用connectEstablished
+    void establishConnections(const std::vector<TcpConnectionPtr> &conns);
+    void establishConnection(const TcpConnectionPtr &conn);
     void removeConnection(const TcpConnectionPtr &conn);
     void removeConnectionInLoop(const TcpConnectionPtr &conn);
 
-    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    using ConnectionMap = std::unordered_map<uint64_t, TcpConnectionPtr>;
+    // 每个loop一个分片，只在这个loop线程中读写，登记和删除连接都不需要加锁，也不用绕回baseLoop
+    using ConnectionShardMap = std::unordered_map<EventLoop*, std::shared_ptr<ConnectionMap>>;
+    using TimingWheelMap = std::unordered_map<EventLoop*, std::shared_ptr<TimingWheel>>;
 
     EventLoop *loop_; // baseLoop 用户定义的loop
 
     const std::string ipPort_;
     const std::string name_;
+    const std::shared_ptr<const std::string> connNamePrefix_; // 连接名字的公共部分name-ip:port，连接的名字是它加上#id
+    const InetAddress listenAddr_;
+    const Option option_;
 
-    std::unique_ptr<Acceptor> acceptor_; // 运行在mainLoop，任务就是监听新连接事件
+    std::unique_ptr<Acceptor> acceptor_; // 运行在mainLoop，任务就是监听新连接事件；kReusePortPerLoop时只在没有subloop时由start创建
 
     std::shared_ptr<EventLoopThreadPool> threadPool_; // one loop per thread
+    // kReusePortPerLoop时每个subloop的Acceptor，TcpServer析构时交给各自的loop去释放，等释放完才返回
+    std::vector<std::shared_ptr<Acceptor>> loopAcceptors_;
 
     ConnectionCallback connectionCallback_; // 有新连接时的回调
     MessageCallback messageCallback_; // 有读写消息时的回调
@@ -70,6 +129,16 @@ private:
 
     std::atomic_int started_;
 
-    int nextConnId_;
-    ConnectionMap connections_; // 保存所有的连接
+    std::atomic<uint64_t> nextConnId_; // kReusePortPerLoop时多个subloop会同时创建连接
+    ConnectionShardMap connections_; // 保存所有的连接，按所属loop分片，start之后只读
+
+    bool chainOutputBuffer_; // 连接是否使用ChainBuffer作为发送缓冲区
+    bool autoCork_; // 连接是否开启自动合并写
+    bool completionIo_; // 连接是否使用完成模式
+    bool edgeTriggered_; // 连接是否使用边沿触发
+    int acceptBatch_;
+    double acceptBackoff_;
+    double maxAcceptBackoff_;
+    int idleSeconds_; // 空闲超时秒数，0表示不开启
+    TimingWheelMap idleWheels_; // 每个loop一个时间轮，start之后只读
 };
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+
+#include <atomic>
+
+/**
+ * 定时器，记录到期回调、到期时间以及重复间隔
+ * Timer只在TimerQueue内部使用，用户通过TimerId来引用它
+ */
+class Timer : noncopyable
+{
+public:
+    Timer(TimerCallback cb, Timestamp when, double interval)
+        : callback_(std::move(cb))
+        , expiration_(when)
+        , interval_(interval)
+        , repeat_(interval > 0.0)
+        , sequence_(++numCreated_)
+    {}
+
+    void run() const { callback_(); } // 执行到期回调
+
+    Timestamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    // 重复定时器到期后，以now为基准计算下一次到期时间
+    void restart(Timestamp now);
+
+    static int64_t numCreated() { return numCreated_; }
+private:
+    const TimerCallback callback_;
+    Timestamp expiration_; // 到期时间
+    const double interval_; // 重复间隔，单位秒，<=0 表示一次性定时器
+    const bool repeat_;
+    const int64_t sequence_; // 全局唯一序号，用来区分地址被复用的Timer对象
+
+    static std::atomic<int64_t> numCreated_;
+};
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+#include "TimerId.h"
+
+#include <set>
+#include <vector>
+
+class EventLoop;
+class Timer;
+
+/**
+ * 定时器队列，每个EventLoop拥有一个
+ * 所有定时器共用一个timerfd，timerfd总是设置为最早到期的那个定时器的时间，
+ * timerfd可读时由Poller通知timerfdChannel_，在loop线程中执行到期的回调，不需要额外的wakeup
+ * 定时器按 <到期时间, Timer*> 保存在std::set里，插入和删除都是O(log n)
+ */
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // 添加定时器，线程安全，可以在其他线程调用
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+
+    // 取消定时器，线程安全
+    void cancel(TimerId timerId);
+
+private:
+    using Entry = std::pair<Timestamp, Timer*>;
+    using TimerList = std::set<Entry>;
+    using ActiveTimer = std::pair<Timer*, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(TimerId timerId);
+
+    // timerfd可读时的回调，执行所有到期的定时器
+    void handleRead();
+
+    // 取出所有到期的定时器
+    std::vector<Entry> getExpired(Timestamp now);
+    // 重复定时器重新插入队列，一次性定时器释放掉
+    void reset(const std::vector<Entry> &expired, Timestamp now);
+
+    // 插入定时器，返回最早到期时间是否改变
+    bool insert(Timer *timer);
+
+    EventLoop *loop_; // 定时器队列所属的loop
+    const int timerfd_;
+    Channel timerfdChannel_;
+
+    TimerList timers_; // 按到期时间排序的定时器
+
+    // 下面两个集合用于cancel，按<Timer*, sequence>查找
+    ActiveTimerSet activeTimers_; // 和timers_保存的是同一批定时器
+    bool callingExpiredTimers_;
+    ActiveTimerSet cancelingTimers_; // 在执行到期回调的过程中被取消的定时器
+};
\ No newline at end of file
@@ -1,20 +1,46 @@
 #include "Timestamp.h"
 
+#include <stdio.h>
 #include <time.h>
 
 Timestamp::Timestamp():microSecondsSinceEpoch_(0) {} //默认构造函数，置0
 
 Timestamp::Timestamp(int64_t microSecondsSinceEpoch): microSecondsSinceEpoch_(microSecondsSinceEpoch) {} //拷贝构造函数，赋值
 
-Timestamp Timestamp::now(){ return Timestamp(time(NULL)); } // 获取当前系统的当前日期，时间 
+// 获取当前系统的当前日期，时间，精确到微秒（定时器和收包时间需要亚秒级精度）
+Timestamp Timestamp::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
+
+Timestamp Timestamp::monotonicNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
 
 std::string Timestamp::toString() const 
 {
-    char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_); // man localtime 可以看到localtime会返回一个struct 
-    snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d", 
-        tm_time->tm_year + 1900, tm_time->tm_mon + 1,tm_time->tm_mday,
-        tm_time->tm_hour,tm_time->tm_min,tm_time->tm_sec);
+    return toFormattedString(false);
+}
+
+std::string Timestamp::toFormattedString(bool showMicroseconds) const
+{
+    char buf[64] = {0};
+    time_t seconds = secondsSinceEpoch();
+    struct tm tm_time;
+    localtime_r(&seconds, &tm_time); // 可重入版本，多个线程同时调用不会互相覆盖
+    int len = snprintf(buf, sizeof buf, "%4d/%02d/%02d %02d:%02d:%02d",
+        tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+        tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+    if (showMicroseconds)
+    {
+        int microseconds = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+        snprintf(buf + len, sizeof buf - len, ".%06d", microseconds);
+    }
     return buf; // buf就是时间的字符串格式
 }
 
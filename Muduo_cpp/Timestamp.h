@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <string>
+#include <time.h>
 
 // 时间类
 class Timestamp
@@ -9,8 +10,43 @@ class Timestamp
 public:
     Timestamp(); 
     explicit Timestamp(int64_t microSecondsSinceEpoch); //explicit 防止隐式构造转换
-    static Timestamp now(); //静态方法
+    static Timestamp now(); //静态方法，CLOCK_REALTIME，微秒精度
+    // CLOCK_MONOTONIC，不受系统校时影响，只能用来计算时间差，不能转换成日期
+    static Timestamp monotonicNow();
     std::string toString() const; //将时间戳转换成年月日时分秒的可视化string
+    std::string toFormattedString(bool showMicroseconds = true) const; // 年月日时分秒.微秒
+
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    time_t secondsSinceEpoch() const
+    { return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond); }
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
 private:
     int64_t microSecondsSinceEpoch_; //表示时间
-};
\ No newline at end of file
+};
+
+// 定时器队列按到期时间排序，需要比较运算
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// 两个时间点相差的秒数，high - low
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+// 在timestamp的基础上增加seconds秒，得到新的时间点
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "TimingWheel.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+#include "Logger.h"
+
+TimingWheel::Entry::~Entry()
+{
+    TcpConnectionPtr conn = weakConn_.lock();
+    if (conn) // 连接还活着，说明idleSeconds内都没有收到数据
+    {
+        LOG_INFO("TimingWheel close idle connection [%s] \n", conn->name().c_str());
+        conn->forceClose();
+    }
+}
+
+TimingWheel::TimingWheel(EventLoop *loop, int idleSeconds)
+    : loop_(loop)
+    , idleSeconds_(idleSeconds > 0 ? idleSeconds : 1)
+    , buckets_(idleSeconds_ + 1)
+    , tail_(0)
+{
+}
+
+TimingWheel::~TimingWheel()
+{
+    loop_->cancel(timerId_);
+}
+
+void TimingWheel::start()
+{
+    // 定时器只持有弱引用，时间轮析构以后tick自动失效
+    timerId_ = loop_->runEvery(1.0,
+        std::bind(&TimingWheel::onTickWeak, std::weak_ptr<TimingWheel>(shared_from_this())));
+}
+
+TimingWheel::WeakEntryPtr TimingWheel::add(const TcpConnectionPtr &conn)
+{
+    EntryPtr entry(new Entry(conn));
+    buckets_[tail_].insert(entry);
+    return entry;
+}
+
+void TimingWheel::touch(const WeakEntryPtr &weakEntry)
+{
+    EntryPtr entry = weakEntry.lock();
+    if (entry)
+    {
+        buckets_[tail_].insert(entry); // 同一个桶里重复insert只保留一份
+    }
+}
+
+void TimingWheel::onTickWeak(const std::weak_ptr<TimingWheel> &weakWheel)
+{
+    std::shared_ptr<TimingWheel> wheel = weakWheel.lock();
+    if (wheel)
+    {
+        wheel->onTick();
+    }
+}
+
+void TimingWheel::onTick()
+{
+    // 前进一格，这一格保存的是idleSeconds+1次tick之前的桶
+    tail_ = (tail_ + 1) % buckets_.size();
+    Bucket expired;
+    expired.swap(buckets_[tail_]);
+    // expired出作用域时，不在其他桶里的Entry被析构，批量关闭这一秒到期的空闲连接
+}
\ No newline at end of file
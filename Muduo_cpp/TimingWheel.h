@@ -0,0 +1,57 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+
+#include <memory>
+#include <vector>
+#include <unordered_set>
+
+class EventLoop;
+
+/**
+ * 踢掉空闲连接的时间轮，每个subLoop一个，只在所属loop的线程中使用
+ * 时间轮有idleSeconds+1个桶，每秒tick一次，tick时丢弃最老的那个桶
+ * Entry是在一秒中间放进最新的桶的，离下一次tick不到一秒，多一个桶保证连接至少空闲满idleSeconds秒才被关闭
+ * 连接收到数据时只需要把自己的Entry放进最新的桶（touch，O(1)），不需要对定时器堆做任何操作
+ * 一个Entry被所有桶都丢弃后引用计数归零，析构时关闭对应的连接，所以每个tick批量关闭一批到期连接
+ */
+class TimingWheel : noncopyable, public std::enable_shared_from_this<TimingWheel>
+{
+public:
+    struct Entry
+    {
+        explicit Entry(const WeakTcpConnectionPtr &weakConn): weakConn_(weakConn) {}
+        ~Entry(); // 连接空闲超时，关闭连接
+
+        WeakTcpConnectionPtr weakConn_;
+    };
+    using EntryPtr = std::shared_ptr<Entry>;
+    using WeakEntryPtr = std::weak_ptr<Entry>;
+
+    TimingWheel(EventLoop *loop, int idleSeconds);
+    ~TimingWheel();
+
+    // 启动每秒一次的tick，必须在shared_ptr管理之后调用
+    void start();
+
+    // 新连接加入时间轮，返回的WeakEntryPtr由连接保存，在loop线程调用
+    WeakEntryPtr add(const TcpConnectionPtr &conn);
+    // 连接有数据到来，把它的Entry放入最新的桶，在loop线程调用
+    void touch(const WeakEntryPtr &weakEntry);
+
+    int idleSeconds() const { return idleSeconds_; }
+
+private:
+    using Bucket = std::unordered_set<EntryPtr>;
+
+    static void onTickWeak(const std::weak_ptr<TimingWheel> &weakWheel);
+    void onTick();
+
+    EventLoop *loop_; // 时间轮所属的loop
+    const int idleSeconds_;
+    std::vector<Bucket> buckets_; // 环形数组，buckets_[tail_]是最新的桶
+    size_t tail_;
+    TimerId timerId_; // 每秒tick的定时器
+};
\ No newline at end of file
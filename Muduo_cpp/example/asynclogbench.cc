@@ -0,0 +1,56 @@
+#include <mymuduo/AsyncLogging.h>
+#include <mymuduo/Logger.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/**
+ * 异步日志的吞吐量测试，多个线程同时LOG_INFO，日志写到当前目录下的asynclogbench.*.log
+ *
+ * 用法: ./asynclogbench [线程数] [每个线程写的行数]
+ */
+
+static AsyncLogging *g_asyncLog = nullptr;
+
+static void asyncOutput(const char *msg, int len)
+{
+    g_asyncLog->append(msg, len);
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    int perThread = argc > 2 ? atoi(argv[2]) : 1000000;
+
+    AsyncLogging log("asynclogbench", 500 * 1024 * 1024);
+    g_asyncLog = &log;
+    log.start();
+    Logger::setOutput(asyncOutput);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<std::thread>> workers;
+    for (int i = 0; i < threads; ++i)
+    {
+        workers.emplace_back(new std::thread([i, perThread]() {
+            for (int j = 0; j < perThread; ++j)
+            {
+                LOG_INFO("thread %d line %d abcdefghijklmnopqrstuvwxyz", i, j);
+            }
+        }));
+    }
+    for (auto &t : workers)
+    {
+        t->join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    log.stop();
+
+    int64_t total = static_cast<int64_t>(threads) * perThread;
+    printf("threads=%d lines=%ld time=%.3fs throughput=%.0f lines/s dropped buffers=%ld\n",
+        threads, total, elapsed, total / elapsed, log.droppedBuffers());
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/MpscQueue.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * 跨线程投递回调的吞吐量测试
+ * 1. 队列本身：原来的 mutex + vector 交换 对比 MpscQueue
+ * 2. 端到端：多个线程调用EventLoop::queueInLoop投递到同一个loop（对应多个subLoop调用TcpServer::removeConnection）
+ *
+ * 用法: ./postbench [生产者线程数] [每个线程投递的个数]
+ */
+
+using Functor = std::function<void()>;
+using Clock = std::chrono::steady_clock;
+
+// 原来EventLoop中pendingFunctors_的实现
+class MutexQueue
+{
+public:
+    void push(Functor cb)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        functors_.emplace_back(std::move(cb));
+    }
+
+    size_t drain()
+    {
+        std::vector<Functor> functors;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            functors.swap(functors_);
+        }
+        for (const Functor &functor : functors)
+        {
+            functor();
+        }
+        return functors.size();
+    }
+private:
+    std::mutex mutex_;
+    std::vector<Functor> functors_;
+};
+
+class LockFreeQueue
+{
+public:
+    void push(Functor cb) { queue_.push(std::move(cb)); }
+
+    size_t drain()
+    {
+        size_t n = 0;
+        Functor functor;
+        while (queue_.pop(&functor))
+        {
+            functor();
+            ++n;
+        }
+        return n;
+    }
+private:
+    MpscQueue<Functor> queue_;
+};
+
+static double seconds(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+template <typename Queue>
+static void benchQueue(const char *name, int producers, int perThread)
+{
+    Queue queue;
+    std::atomic<int64_t> sum(0);
+    const int64_t total = static_cast<int64_t>(producers) * perThread;
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::unique_ptr<std::thread>> threads;
+    for (int i = 0; i < producers; ++i)
+    {
+        threads.emplace_back(new std::thread([&queue, &sum, perThread]() {
+            for (int j = 0; j < perThread; ++j)
+            {
+                queue.push([&sum]() { sum.fetch_add(1, std::memory_order_relaxed); });
+            }
+        }));
+    }
+
+    int64_t consumed = 0;
+    while (consumed < total) // 单消费者不停地取
+    {
+        consumed += queue.drain();
+    }
+    double elapsed = seconds(start);
+    for (auto &t : threads)
+    {
+        t->join();
+    }
+
+    printf("%-12s producers=%d posts=%ld time=%.3fs throughput=%.0f posts/s\n",
+        name, producers, total, elapsed, total / elapsed);
+}
+
+static void benchEventLoop(int producers, int perThread)
+{
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+
+    std::atomic<int64_t> sum(0);
+    const int64_t total = static_cast<int64_t>(producers) * perThread;
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::unique_ptr<std::thread>> threads;
+    for (int i = 0; i < producers; ++i)
+    {
+        threads.emplace_back(new std::thread([loop, &sum, perThread]() {
+            for (int j = 0; j < perThread; ++j)
+            {
+                loop->queueInLoop([&sum]() { sum.fetch_add(1, std::memory_order_relaxed); });
+            }
+        }));
+    }
+    for (auto &t : threads)
+    {
+        t->join();
+    }
+    while (sum.load() < total)
+    {
+        std::this_thread::yield();
+    }
+    double elapsed = seconds(start);
+
+    printf("%-12s producers=%d posts=%ld time=%.3fs throughput=%.0f posts/s suppressedWakeups=%ld\n",
+        "queueInLoop", producers, total, elapsed, total / elapsed, loop->suppressedWakeups());
+}
+
+int main(int argc, char *argv[])
+{
+    int producers = argc > 1 ? atoi(argv[1]) : 16;
+    int perThread = argc > 2 ? atoi(argv[2]) : 100000;
+
+    benchQueue<MutexQueue>("mutex+vector", producers, perThread);
+    benchQueue<LockFreeQueue>("MpscQueue", producers, perThread);
+    benchEventLoop(producers, perThread);
+    return 0;
+}
\ No newline at end of file